@@ -0,0 +1,269 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "barr.h"
+#include "atomic_bitset.h"
+
+/*
+* lock-free bitset for slot claiming. every word is read and written with
+* the __atomic builtins: claims are CAS loops with acquire-release order, so
+* whoever claims a slot sees everything its previous owner wrote before
+* releasing it.
+*/
+#ifndef __GNUC__
+#error "atomic_bitset.c needs the __atomic builtins (gcc or clang)"
+#endif
+
+#define WORD_INDEX(index) ((index) / LENGTH)
+#define BIT_OFFSET(index) ((index) % LENGTH)
+#define BIT_MASK(index) (1UL << BIT_OFFSET(index))
+#define WORDS_FOR_BITS(bits) (((bits) + LENGTH - 1) / LENGTH)
+#define LOAD(word) __atomic_load_n(&(word), __ATOMIC_ACQUIRE)
+#define FULL_WORD (~0UL)
+#define CACHE_LINE 64
+
+/*
+* hint is written by claims and releases from every thread, so the padding
+* keeps it off the lines of the read-only fields and of the first words.
+*/
+struct atomic_bitset_t
+{
+	size_t num_of_bits;
+	size_t num_of_words;
+	unsigned long *words;
+	char padding_before_hint[CACHE_LINE];
+	size_t hint; /*a word that was recently seen with a free bit*/
+	char padding_after_hint[CACHE_LINE];
+};
+
+/*
+* receives the number of bits (slots) the set should hold.
+* creates a bitset with every bit off. the bits past num_of_bits are kept on
+* so that no claim can ever return them.
+* returns the bitset if succeeded, NULL otherwise.
+* O(n).
+*/
+atomic_bitset_t *AtomicBitSetCreate(size_t num_of_bits)
+{
+	atomic_bitset_t *set = NULL;
+	size_t num_of_words = 0;
+
+	assert(0 < num_of_bits);
+
+	num_of_words = WORDS_FOR_BITS(num_of_bits);
+	set = malloc(sizeof(atomic_bitset_t) +
+									num_of_words * sizeof(unsigned long));
+	if (NULL == set)
+	{
+		return NULL;
+	}
+
+	set->num_of_bits = num_of_bits;
+	set->num_of_words = num_of_words;
+	set->hint = 0;
+	set->words = (unsigned long *)((char *)set + sizeof(atomic_bitset_t));
+	memset(set->words, 0, num_of_words * sizeof(unsigned long));
+
+	if (0 != BIT_OFFSET(num_of_bits))
+	{
+		set->words[num_of_words - 1] = FULL_WORD << BIT_OFFSET(num_of_bits);
+	}
+
+	return set;
+}
+
+/*
+* receives a bitset and frees it. no other thread may still be using it.
+* O(1).
+*/
+void AtomicBitSetDestroy(atomic_bitset_t *set)
+{
+	assert(set);
+
+	free(set);
+}
+
+size_t AtomicBitSetSize(const atomic_bitset_t *set)
+{
+	assert(set);
+
+	return set->num_of_bits;
+}
+
+int AtomicBitSetIsOn(const atomic_bitset_t *set, size_t index)
+{
+	assert(set);
+	assert(index < set->num_of_bits);
+
+	return (0 != (LOAD(set->words[WORD_INDEX(index)]) & BIT_MASK(index)));
+}
+
+/*
+* receives a bitset and an index.
+* turns the bit on atomically.
+* returns the previous value of the bit, so 0 means this caller claimed it.
+* O(1).
+*/
+int AtomicBitSetSetOn(atomic_bitset_t *set, size_t index)
+{
+	assert(set);
+	assert(index < set->num_of_bits);
+
+	return (0 != (__atomic_fetch_or(&set->words[WORD_INDEX(index)],
+							BIT_MASK(index), __ATOMIC_ACQ_REL) & BIT_MASK(index)));
+}
+
+/*
+* points the hint at a word that a release just gave room to. the shared
+* line is only written when the word was full before, so claims could not
+* have found it, or when it is below the current hint.
+*/
+static void MoveHint(atomic_bitset_t *set, size_t word,
+												unsigned long old_word)
+{
+	if (FULL_WORD == old_word ||
+		word < __atomic_load_n(&set->hint, __ATOMIC_RELAXED))
+	{
+		__atomic_store_n(&set->hint, word, __ATOMIC_RELAXED);
+	}
+}
+
+/*
+* receives a bitset and an index.
+* turns the bit off atomically, publishing the caller's prior writes to the
+* next thread that claims it.
+* returns the previous value of the bit.
+* O(1).
+*/
+int AtomicBitSetSetOff(atomic_bitset_t *set, size_t index)
+{
+	unsigned long old_word = 0;
+
+	assert(set);
+	assert(index < set->num_of_bits);
+
+	old_word = __atomic_fetch_and(&set->words[WORD_INDEX(index)],
+									~BIT_MASK(index), __ATOMIC_ACQ_REL);
+	MoveHint(set, WORD_INDEX(index), old_word);
+
+	return (0 != (old_word & BIT_MASK(index)));
+}
+
+static size_t ClaimInWord(atomic_bitset_t *set, size_t word)
+{
+	unsigned long expected = LOAD(set->words[word]);
+	unsigned long bit = 0;
+
+	while (FULL_WORD != expected)
+	{
+		bit = BitsArrayFindFirstOff(expected);
+
+		/*on failure expected is reloaded and the next free bit is tried*/
+		if (__atomic_compare_exchange_n(&set->words[word], &expected,
+								expected | (1UL << bit), 0,
+								__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		{
+			return (word * LENGTH + bit);
+		}
+	}
+
+	return set->num_of_bits;
+}
+
+/*
+* receives a bitset.
+* finds a bit that is off and turns it on atomically, retrying on the next
+* free bit when another thread wins the same one. the scan starts at a word
+* recently seen with room, then wraps around.
+* returns the claimed index, or the set size if every bit is on.
+* O(n / LENGTH) worst case, O(1) while the hint word has room.
+*/
+size_t AtomicBitSetClaimFirstOff(atomic_bitset_t *set)
+{
+	size_t start = 0, word = 0, i = 0;
+	size_t index = 0;
+
+	assert(set);
+
+	start = __atomic_load_n(&set->hint, __ATOMIC_RELAXED);
+	if (start >= set->num_of_words)
+	{
+		start = 0;
+	}
+
+	for (i = 0; i < set->num_of_words; ++i)
+	{
+		word = start + i;
+		if (word >= set->num_of_words)
+		{
+			word -= set->num_of_words;
+		}
+
+		index = ClaimInWord(set, word);
+		if (index != set->num_of_bits)
+		{
+			if (word != start)
+			{
+				__atomic_store_n(&set->hint, word, __ATOMIC_RELAXED);
+			}
+
+			return index;
+		}
+	}
+
+	return set->num_of_bits;
+}
+
+/*
+* receives a bitset, an array of indexes and its length.
+* turns all of the given bits off, with one atomic operation per word when
+* consecutive indexes fall in the same word (e.g. a sorted array).
+* O(count).
+*/
+void AtomicBitSetReleaseMany(atomic_bitset_t *set, const size_t *indexes,
+																size_t count)
+{
+	unsigned long mask = 0, old_word = 0;
+	size_t word = 0, i = 0;
+
+	assert(set);
+	assert(indexes || 0 == count);
+
+	while (i < count)
+	{
+		word = WORD_INDEX(indexes[i]);
+		mask = 0;
+
+		for (; i < count && WORD_INDEX(indexes[i]) == word; ++i)
+		{
+			assert(indexes[i] < set->num_of_bits);
+			mask |= BIT_MASK(indexes[i]);
+		}
+
+		old_word = __atomic_fetch_and(&set->words[word], ~mask,
+														__ATOMIC_RELEASE);
+		MoveHint(set, word, old_word);
+	}
+}
+
+/*
+* receives a bitset.
+* returns the number of bits that are on. the count is a snapshot taken
+* word by word, so it is exact only while no other thread is changing bits.
+* O(n).
+*/
+size_t AtomicBitSetCountOn(const atomic_bitset_t *set)
+{
+	size_t counter = 0, word = 0;
+
+	assert(set);
+
+	for (word = 0; word < set->num_of_words; ++word)
+	{
+		counter += BitsArrayCountOn(LOAD(set->words[word]));
+	}
+
+	/*the always-on padding bits*/
+	return (counter - (set->num_of_words * LENGTH - set->num_of_bits));
+}
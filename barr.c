@@ -1,20 +1,180 @@
 #include "barr.h"
 #include <assert.h>
 
-size_t BitsArrayCountOn(unsigned long bit_array)
+#if defined(__GNUC__) && defined(__x86_64__)
+#define X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+#define M1 0x5555555555555555UL
+#define M2 0x3333333333333333UL
+#define M4 0x0f0f0f0f0f0f0f0fUL
+#define H01 0x0101010101010101UL
+
+/*256 entry popcount table, expanded at compile time*/
+#define B2(n) n, n + 1, n + 1, n + 2
+#define B4(n) B2(n), B2(n + 1), B2(n + 1), B2(n + 2)
+#define B6(n) B4(n), B4(n + 1), B4(n + 1), B4(n + 2)
+
+static const unsigned char count_on_lut[256] = 
+{
+	B6(0), B6(1), B6(1), B6(2)
+};
+
+/*256 entry bit reversal table, expanded at compile time*/
+#define R2(n) n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define R4(n) R2(n), R2(n + 2 * 16), R2(n + 1 * 16), R2(n + 3 * 16)
+#define R6(n) R4(n), R4(n + 2 * 4), R4(n + 1 * 4), R4(n + 3 * 4)
+
+static const unsigned char mirror_lut[256] =
+{
+	R6(0), R6(2), R6(1), R6(3)
+};
+
+typedef size_t (*count_word_func_t)(unsigned long);
+typedef size_t (*count_buffer_func_t)(const unsigned long *, size_t);
+
+static size_t CountOnSwar(unsigned long bit_array)
+{
+	bit_array -= (bit_array >> 1) & M1;
+	bit_array = (bit_array & M2) + ((bit_array >> 2) & M2);
+	bit_array = (bit_array + (bit_array >> 4)) & M4;
+
+	return ((bit_array * H01) >> (LENGTH - 8));
+}
+
+static size_t CountBufferPortable(const unsigned long *bit_arrays,
+														size_t num_of_arrays)
 {
 	size_t counter = 0;
+	size_t i = 0;
 
-	while (bit_array)
+	for (i = 0; i < num_of_arrays; ++i)
 	{
-		counter += bit_array & 1;
+		counter += CountOnSwar(bit_arrays[i]);
+	}
+
+	return counter;
+}
 
-		bit_array >>= 1;
+#ifdef X86_DISPATCH
+__attribute__((target("popcnt")))
+static size_t CountOnPopcnt(unsigned long bit_array)
+{
+	return __builtin_popcountl(bit_array);
+}
+
+__attribute__((target("popcnt")))
+static size_t CountBufferPopcnt(const unsigned long *bit_arrays,
+														size_t num_of_arrays)
+{
+	size_t counter = 0;
+	size_t i = 0;
+
+	for (i = 0; i < num_of_arrays; ++i)
+	{
+		counter += __builtin_popcountl(bit_arrays[i]);
 	}
 
 	return counter;
 }
 
+/*
+* nibble shuffle popcount (Mula): every byte is split into two nibbles that
+* index a 16 entry table with PSHUFB, and the byte counts are summed into
+* 64-bit lanes with PSADBW once per 32 bytes.
+*/
+__attribute__((target("avx2,popcnt")))
+static size_t CountBufferAvx2(const unsigned long *bit_arrays,
+														size_t num_of_arrays)
+{
+	const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+										 1, 2, 2, 3, 2, 3, 3, 4,
+										 0, 1, 1, 2, 1, 2, 2, 3,
+										 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+	__m256i total = _mm256_setzero_si256();
+	__m256i chunk, low, high, bytes;
+	size_t words_per_chunk = sizeof(__m256i) / sizeof(unsigned long);
+	size_t i = 0;
+	size_t counter = 0;
+
+	for (; i + words_per_chunk <= num_of_arrays; i += words_per_chunk)
+	{
+		chunk = _mm256_loadu_si256((const __m256i *)(bit_arrays + i));
+		low = _mm256_and_si256(chunk, low_mask);
+		high = _mm256_and_si256(_mm256_srli_epi16(chunk, 4), low_mask);
+		bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lut, low),
+											_mm256_shuffle_epi8(lut, high));
+		total = _mm256_add_epi64(total,
+							_mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+	}
+
+	counter = (size_t)_mm256_extract_epi64(total, 0) +
+			  (size_t)_mm256_extract_epi64(total, 1) +
+			  (size_t)_mm256_extract_epi64(total, 2) +
+			  (size_t)_mm256_extract_epi64(total, 3);
+
+	for (; i < num_of_arrays; ++i)
+	{
+		counter += __builtin_popcountl(bit_arrays[i]);
+	}
+
+	return counter;
+}
+#endif
+
+static count_word_func_t count_word = CountOnSwar;
+static count_buffer_func_t count_buffer = CountBufferPortable;
+
+#ifdef X86_DISPATCH
+/*
+* picks the word and buffer kernels once at load time, so no caller can
+* race on a lazily initialized pointer.
+*/
+__attribute__((constructor))
+static void PickCountBuffer(void)
+{
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("popcnt"))
+	{
+		count_word = CountOnPopcnt;
+		count_buffer = CountBufferPopcnt;
+	}
+
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+	{
+		count_buffer = CountBufferAvx2;
+	}
+}
+#endif
+
+/*
+* receives a bit array.
+* returns the number of bits that are on, with the POPCNT instruction when
+* the cpu has it and SWAR otherwise.
+* O(1).
+*/
+size_t BitsArrayCountOn(unsigned long bit_array)
+{
+	return count_word(bit_array);
+}
+
+/*
+* receives a buffer of bit arrays and its length.
+* returns the number of bits that are on in the whole buffer, using the
+* fastest kernel the cpu supports (AVX2, POPCNT, then portable SWAR).
+* O(n).
+*/
+size_t BitsArrayCountOnBuffer(const unsigned long *bit_arrays,
+														size_t num_of_arrays)
+{
+	assert(bit_arrays || 0 == num_of_arrays);
+
+	return count_buffer(bit_arrays, num_of_arrays);
+}
+
 size_t BitsArrayCountOff(unsigned long bit_array)
 {
 	return (LENGTH - BitsArrayCountOn(bit_array));
@@ -22,14 +182,14 @@ size_t BitsArrayCountOff(unsigned long bit_array)
 
 int BitsArrayIsOn(unsigned long bit_array, size_t index)
 {
-	assert(index > 0 && index < LENGTH);
+	assert(index < LENGTH);
 
 	return ((bit_array >> index) & 1UL);
 }
 
 int BitsArrayIsOff(unsigned long bit_array, size_t index)
 {
-	assert(index > 0 && index < LENGTH);
+	assert(index < LENGTH);
 
 	return (!((bit_array >> index) & 1UL));
 }
@@ -38,7 +198,7 @@ unsigned long BitsArraySetOn(unsigned long bit_array, size_t index)
 {
 	unsigned long mask = 1;
 
-	assert(index > 0 && index < LENGTH);
+	assert(index < LENGTH);
 
 	mask <<= index;
 
@@ -49,7 +209,7 @@ unsigned long BitsArraySetOff(unsigned long bit_array, size_t index)
 {
 	unsigned long mask = 1;
 
-	assert(index > 0 && index < LENGTH);
+	assert(index < LENGTH);
 
 	if (1 == BitsArrayIsOff(bit_array, index))
 	{
@@ -63,7 +223,7 @@ unsigned long BitsArraySetOff(unsigned long bit_array, size_t index)
 
 unsigned long BitsArraySetBit(unsigned long bit_array, size_t index, int value)
 {
-	assert(index > 0 && index < LENGTH);
+	assert(index < LENGTH);
 	assert(value == 1 || value == 0);
 
 	if (1 == value)
@@ -78,13 +238,63 @@ unsigned long BitsArrayFlipBit(unsigned long bit_array, size_t index)
 {
 	unsigned long mask = 1;
 
-	assert(index > 0 && index < LENGTH);
+	assert(index < LENGTH);
 
 	mask <<= index;
 
 	return (bit_array ^ mask);
 }
 
+/*
+* receives a bit array.
+* returns the index of the lowest bit that is on, or LENGTH if none is.
+* O(1), a single tzcnt/bsf where the compiler has it.
+*/
+size_t BitsArrayFindFirstOn(unsigned long bit_array)
+{
+	if (0 == bit_array)
+	{
+		return LENGTH;
+	}
+
+#ifdef __GNUC__
+	return __builtin_ctzl(bit_array);
+#else
+	return BitsArrayCountOn((bit_array & (~bit_array + 1)) - 1);
+#endif
+}
+
+/*
+* receives a bit array.
+* returns the index of the highest bit that is on, or LENGTH if none is.
+* O(1), a single lzcnt/bsr where the compiler has it.
+*/
+size_t BitsArrayFindLastOn(unsigned long bit_array)
+{
+	if (0 == bit_array)
+	{
+		return LENGTH;
+	}
+
+#ifdef __GNUC__
+	return (LENGTH - 1 - __builtin_clzl(bit_array));
+#else
+	bit_array |= bit_array >> 1;
+	bit_array |= bit_array >> 2;
+	bit_array |= bit_array >> 4;
+	bit_array |= bit_array >> 8;
+	bit_array |= bit_array >> 16;
+	bit_array |= bit_array >> 32;
+
+	return (BitsArrayCountOn(bit_array) - 1);
+#endif
+}
+
+size_t BitsArrayFindFirstOff(unsigned long bit_array)
+{
+	return BitsArrayFindFirstOn(~bit_array);
+}
+
 unsigned long BitsArrayRotL(unsigned long bit_array, size_t number_of_shifts)
 {
 	unsigned long a = (bit_array >> (LENGTH - number_of_shifts));
@@ -108,7 +318,7 @@ unsigned long BitsArrayMirror(unsigned long bit_array)
  	bit_array = (((bit_array & 0xcccccccccccccccc) >> 2)  | ((bit_array & 0x3333333333333333) << 2));
  	bit_array = (((bit_array & 0xf0f0f0f0f0f0f0f0) >> 4)  | ((bit_array & 0x0f0f0f0f0f0f0f0f) << 4));
  	bit_array = (((bit_array & 0xff00ff00ff00ff00) >> 8)  | ((bit_array & 0x00ff00ff00ff00ff) << 8));
- 	bit_array = (((bit_array & 0xffffffff00000000) >> 16) | ((bit_array & 0x00000000ffffffff) << 16));
+ 	bit_array = (((bit_array & 0xffff0000ffff0000) >> 16) | ((bit_array & 0x0000ffff0000ffff) << 16));
  	 
 	return ((bit_array >> 32) | (bit_array << 32));
 }
@@ -126,59 +336,198 @@ void BitsArrayPrintBinary(unsigned long bit_array)
 unsigned long BitsArrayCountOnLUT(unsigned long bit_array)
 {
 	unsigned int i = 0, res = 0;
-	static char arr[256] = {0};
-	static int flag = 0;
 
-	if (0 == flag)
+	for (i = 0; i < sizeof(unsigned long); i++)
 	{
-		for (; i < 256; i++)
-		{
-			arr[i] = BitsArrayCountOn(i);
-		}
-
-		flag = 1;
+		res += count_on_lut[(bit_array >> i * 8) & 0x00000000000000FF];
 	}
 
-	for (i=0; i < 7; i++)
+	return res;
+}
+
+unsigned long BitsArrayMirrorLUT(unsigned long bit_array)
+{
+	unsigned long res = 0;
+	unsigned int i = 0;
+
+	for (i = 0; i < sizeof(unsigned long); i++)
 	{
-		res += (unsigned int)arr[((bit_array >> i * 8) & 0x00000000000000FF)];
+		res = (res << 8) | mirror_lut[bit_array & 0x00000000000000ff];
+
+		bit_array >>= 8;
 	}
 
 	return res;
 }
 
-unsigned long BitsArrayMirrorLUT(unsigned long bit_array)
+typedef void (*mirror_bytes_func_t)(unsigned char *, size_t);
+typedef void (*mirror_buffer_func_t)(unsigned long *, size_t);
+
+static void MirrorBytesPortable(unsigned char *bytes, size_t num_of_bytes)
 {
-	unsigned long res = 0;
-	static unsigned char arr[256] = {0};
-	static int flag = 0;
-	unsigned int helper = 0, i = 0;
+	size_t i = 0;
 
-	if (0 == flag)
+	for (i = 0; i < num_of_bytes; ++i)
 	{
-		for (; i < 256; i++)
-		{
-			helper = (((helper & 0xaaaaaaaa) >> 1)  | ((helper & 0x55555555) << 1));
-	 		helper = (((helper & 0xcccccccc) >> 2)  | ((helper & 0x33333333) << 2));
- 			helper = (((helper & 0xf0f0f0f0) >> 4)  | ((helper & 0x0f0f0f0f) << 4));
-			arr[i] = helper;
-			helper = i + 1;
-		}
+		bytes[i] = mirror_lut[bytes[i]];
+	}
+}
+
+/*mirrors the words between low and high, pairing them from both ends*/
+static void MirrorWords(unsigned long *bit_arrays, size_t low, size_t high)
+{
+	unsigned long temp = 0;
 
-		flag = 1;
+	while (low + 1 < high)
+	{
+		--high;
+		temp = BitsArrayMirror(bit_arrays[low]);
+		bit_arrays[low] = BitsArrayMirror(bit_arrays[high]);
+		bit_arrays[high] = temp;
+		++low;
 	}
 
-	for (i=0; i < 7; i++)
+	if (low + 1 == high)
 	{
-		helper = arr[bit_array & 0x00000000000000ff];
+		bit_arrays[low] = BitsArrayMirror(bit_arrays[low]);
+	}
+}
 
-		res |= helper;
+static void MirrorBufferPortable(unsigned long *bit_arrays,
+														size_t num_of_arrays)
+{
+	MirrorWords(bit_arrays, 0, num_of_arrays);
+}
 
-		bit_array >>= 8;
-		
-		res <<= 8;
+#ifdef X86_DISPATCH
+/*
+* a 256-bit vector is bit-reversed as a whole by reversing its bytes
+* (PSHUFB inside each 64-bit lane, then swapping the lanes) and then the
+* bits inside every byte, either with GF2P8AFFINEQB and the bit reversal
+* matrix, or with two PSHUFB lookups of 16 entry nibble tables.
+*/
+#define GFNI_REVERSE_MATRIX ((long)0x8040201008040201UL)
+
+__attribute__((target("avx2")))
+static __m256i ReverseBytesAvx2(__m256i v)
+{
+	const __m256i swap_mask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+										15, 14, 13, 12, 11, 10, 9, 8,
+										7, 6, 5, 4, 3, 2, 1, 0,
+										15, 14, 13, 12, 11, 10, 9, 8);
+
+	return _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, swap_mask), 0x1b);
+}
+
+__attribute__((target("avx2")))
+static __m256i MirrorEachByteAvx2(__m256i v)
+{
+	const __m256i reversed_high = _mm256_setr_epi8(
+		0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+		0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf,
+		0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+		0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf);
+	const __m256i reversed_low = _mm256_slli_epi16(reversed_high, 4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+
+	return _mm256_or_si256(
+		_mm256_shuffle_epi8(reversed_low, _mm256_and_si256(v, low_mask)),
+		_mm256_shuffle_epi8(reversed_high,
+						_mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask)));
+}
+
+__attribute__((target("gfni,avx2")))
+static __m256i MirrorEachByteGfni(__m256i v)
+{
+	return _mm256_gf2p8affine_epi64_epi8(v,
+								_mm256_set1_epi64x(GFNI_REVERSE_MATRIX), 0);
+}
+
+#define DEFINE_MIRROR_KERNELS(name, target_isa, MIRROR_EACH_BYTE) \
+__attribute__((target(target_isa))) \
+static void MirrorBytes##name(unsigned char *bytes, size_t num_of_bytes) \
+{ \
+	__m256i *chunk = NULL; \
+	size_t i = 0; \
+	for (; i + sizeof(__m256i) <= num_of_bytes; i += sizeof(__m256i)) \
+	{ \
+		chunk = (__m256i *)(bytes + i); \
+		_mm256_storeu_si256(chunk, \
+						MIRROR_EACH_BYTE(_mm256_loadu_si256(chunk))); \
+	} \
+	MirrorBytesPortable(bytes + i, num_of_bytes - i); \
+} \
+__attribute__((target(target_isa))) \
+static void MirrorBuffer##name(unsigned long *bit_arrays, \
+														size_t num_of_arrays) \
+{ \
+	const size_t step = sizeof(__m256i) / sizeof(unsigned long); \
+	__m256i *low_chunk = NULL, *high_chunk = NULL; \
+	__m256i low_value, high_value; \
+	size_t low = 0, high = num_of_arrays; \
+	for (; low + 2 * step <= high; low += step, high -= step) \
+	{ \
+		low_chunk = (__m256i *)(bit_arrays + low); \
+		high_chunk = (__m256i *)(bit_arrays + high - step); \
+		low_value = _mm256_loadu_si256(low_chunk); \
+		high_value = _mm256_loadu_si256(high_chunk); \
+		_mm256_storeu_si256(low_chunk, \
+						MIRROR_EACH_BYTE(ReverseBytesAvx2(high_value))); \
+		_mm256_storeu_si256(high_chunk, \
+						MIRROR_EACH_BYTE(ReverseBytesAvx2(low_value))); \
+	} \
+	MirrorWords(bit_arrays, low, high); \
+}
+
+DEFINE_MIRROR_KERNELS(Avx2, "avx2", MirrorEachByteAvx2)
+DEFINE_MIRROR_KERNELS(Gfni, "gfni,avx2", MirrorEachByteGfni)
+#endif
+
+static mirror_bytes_func_t mirror_bytes = MirrorBytesPortable;
+static mirror_buffer_func_t mirror_buffer = MirrorBufferPortable;
+
+#ifdef X86_DISPATCH
+/*picks the mirror kernels once at load time*/
+__attribute__((constructor))
+static void PickMirrorKernels(void)
+{
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("gfni") && __builtin_cpu_supports("avx2"))
+	{
+		mirror_bytes = MirrorBytesGfni;
+		mirror_buffer = MirrorBufferGfni;
+	}
+	else if (__builtin_cpu_supports("avx2"))
+	{
+		mirror_bytes = MirrorBytesAvx2;
+		mirror_buffer = MirrorBufferAvx2;
 	}
+}
+#endif
+
+/*
+* receives a byte buffer and its length.
+* reverses the bits inside every byte in place (bytes keep their order), as
+* needed to feed reflected CRCs.
+* O(n), with GFNI or AVX2 PSHUFB when the cpu supports them.
+*/
+void BitsArrayMirrorBytes(void *buffer, size_t num_of_bytes)
+{
+	assert(buffer || 0 == num_of_bytes);
 
-	return res;
+	mirror_bytes((unsigned char *)buffer, num_of_bytes);
 }
 
+/*
+* receives a buffer of bit arrays and its length.
+* reverses the bit order of the whole buffer in place, so bit i of the
+* buffer moves to bit (num_of_arrays * LENGTH - 1 - i).
+* O(n), with GFNI or AVX2 PSHUFB when the cpu supports them.
+*/
+void BitsArrayMirrorBuffer(unsigned long *bit_arrays, size_t num_of_arrays)
+{
+	assert(bit_arrays || 0 == num_of_arrays);
+
+	mirror_buffer(bit_arrays, num_of_arrays);
+}
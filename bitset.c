@@ -0,0 +1,827 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "barr.h"
+#include "bitset.h"
+
+#define ALIGNMENT 64
+#define WORDS_PER_LINE (ALIGNMENT / sizeof(unsigned long))
+#define WORD_INDEX(index) ((index) / LENGTH)
+#define BIT_OFFSET(index) ((index) % LENGTH)
+#define BIT_MASK(index) (1UL << BIT_OFFSET(index))
+#define WORDS_FOR_BITS(bits) (((bits) + LENGTH - 1) / LENGTH)
+#define ROUND_TO_LINE(words) \
+	((((words) + WORDS_PER_LINE - 1) / WORDS_PER_LINE) * WORDS_PER_LINE)
+#define WORD(set, index) (set)->words[WORD_INDEX(index)]
+
+#ifdef __GNUC__
+#define ALIGNED_WORDS(set) \
+	((unsigned long *)__builtin_assume_aligned((set)->words, ALIGNMENT))
+#else
+#define ALIGNED_WORDS(set) ((set)->words)
+#endif
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+enum return_status
+{
+	SUCCESS,
+	MALLOC_FAIL
+};
+
+enum set_op
+{
+	OP_AND,
+	OP_OR,
+	OP_XOR,
+	OP_ANDNOT,
+	NUM_OF_OPS
+};
+
+typedef void (*op_kernel_t)(unsigned long *dest, const unsigned long *src1,
+								const unsigned long *src2, size_t num_of_words);
+typedef size_t (*op_count_kernel_t)(const unsigned long *src1,
+								const unsigned long *src2, size_t num_of_words);
+
+struct bitset_t
+{
+	size_t num_of_bits;
+	size_t num_of_words;
+	size_t capacity; /*in words, rounded up to whole cache lines*/
+	unsigned long *words;
+};
+
+/*
+* bits past num_of_bits are kept at zero at all times, so counting and
+* searching never need to mask the tail.
+*/
+static void ClearTail(bitset_t *set)
+{
+	size_t used_bits = BIT_OFFSET(set->num_of_bits);
+
+	if (0 != used_bits)
+	{
+		set->words[set->num_of_words - 1] &= ((1UL << used_bits) - 1);
+	}
+}
+
+static void ShiftWordsL(unsigned long *words, size_t num_of_words,
+														size_t num_of_shifts)
+{
+	size_t word_shift = WORD_INDEX(num_of_shifts);
+	size_t bit_shift = BIT_OFFSET(num_of_shifts);
+	size_t i = num_of_words;
+
+	if (word_shift >= num_of_words)
+	{
+		memset(words, 0, num_of_words * sizeof(unsigned long));
+
+		return;
+	}
+
+	while (i > word_shift + 1)
+	{
+		--i;
+		words[i] = words[i - word_shift] << bit_shift;
+		if (0 != bit_shift)
+		{
+			words[i] |= words[i - word_shift - 1] >> (LENGTH - bit_shift);
+		}
+	}
+
+	words[word_shift] = words[0] << bit_shift;
+	memset(words, 0, word_shift * sizeof(unsigned long));
+}
+
+static void ShiftWordsR(unsigned long *words, size_t num_of_words,
+														size_t num_of_shifts)
+{
+	size_t word_shift = WORD_INDEX(num_of_shifts);
+	size_t bit_shift = BIT_OFFSET(num_of_shifts);
+	size_t last = 0;
+	size_t i = 0;
+
+	if (word_shift >= num_of_words)
+	{
+		memset(words, 0, num_of_words * sizeof(unsigned long));
+
+		return;
+	}
+
+	last = num_of_words - word_shift - 1;
+	for (i = 0; i < last; ++i)
+	{
+		words[i] = words[i + word_shift] >> bit_shift;
+		if (0 != bit_shift)
+		{
+			words[i] |= words[i + word_shift + 1] << (LENGTH - bit_shift);
+		}
+	}
+
+	words[last] = words[num_of_words - 1] >> bit_shift;
+	memset(words + last + 1, 0, word_shift * sizeof(unsigned long));
+}
+
+/*
+* receives the number of bits the set should hold.
+* creates a zeroed bitset whose words start on a cache line and are padded
+* to a whole number of cache lines.
+* returns the bitset if succeeded, NULL otherwise.
+* O(n).
+*/
+bitset_t *BitSetCreate(size_t num_of_bits)
+{
+	bitset_t *set = NULL;
+	size_t num_of_words = 0;
+	size_t capacity = 0;
+	size_t misalignment = 0;
+
+	assert(0 < num_of_bits);
+
+	num_of_words = WORDS_FOR_BITS(num_of_bits);
+	capacity = ROUND_TO_LINE(num_of_words);
+
+	set = malloc(sizeof(bitset_t) + ALIGNMENT +
+										capacity * sizeof(unsigned long));
+	if (NULL == set)
+	{
+		return NULL;
+	}
+
+	set->num_of_bits = num_of_bits;
+	set->num_of_words = num_of_words;
+	set->capacity = capacity;
+	set->words = (unsigned long *)((char *)set + sizeof(bitset_t));
+	misalignment = (size_t)set->words % ALIGNMENT;
+	if (0 != misalignment)
+	{
+		set->words = (unsigned long *)((char *)set->words +
+													ALIGNMENT - misalignment);
+	}
+
+	memset(set->words, 0, capacity * sizeof(unsigned long));
+
+	return set;
+}
+
+/*
+* receives a bitset and frees it.
+* O(1).
+*/
+void BitSetDestroy(bitset_t *set)
+{
+	assert(set);
+
+	free(set);
+}
+
+/*
+* receives a bitset.
+* returns the number of bits it holds.
+* O(1).
+*/
+size_t BitSetSize(const bitset_t *set)
+{
+	assert(set);
+
+	return set->num_of_bits;
+}
+
+/*
+* receives a bitset.
+* returns the number of words backing it.
+* O(1).
+*/
+size_t BitSetNumOfWords(const bitset_t *set)
+{
+	assert(set);
+
+	return set->num_of_words;
+}
+
+/*
+* receives a bitset.
+* returns its cache line aligned word buffer. bit i lives in word i / LENGTH
+* at position i % LENGTH. callers that write to it must keep the bits past
+* BitSetSize at zero.
+* O(1).
+*/
+unsigned long *BitSetData(bitset_t *set)
+{
+	assert(set);
+
+	return set->words;
+}
+
+/*
+* receives a bitset.
+* returns the number of bits that are on.
+* O(n), at memory speed on cpus with POPCNT or AVX2.
+*/
+size_t BitSetCountOn(const bitset_t *set)
+{
+	assert(set);
+
+	return BitsArrayCountOnBuffer(set->words, set->num_of_words);
+}
+
+size_t BitSetCountOff(const bitset_t *set)
+{
+	assert(set);
+
+	return (set->num_of_bits - BitSetCountOn(set));
+}
+
+int BitSetIsOn(const bitset_t *set, size_t index)
+{
+	assert(set);
+	assert(index < set->num_of_bits);
+
+	return (0 != (WORD(set, index) & BIT_MASK(index)));
+}
+
+int BitSetIsOff(const bitset_t *set, size_t index)
+{
+	return (!BitSetIsOn(set, index));
+}
+
+void BitSetSetOn(bitset_t *set, size_t index)
+{
+	assert(set);
+	assert(index < set->num_of_bits);
+
+	WORD(set, index) |= BIT_MASK(index);
+}
+
+void BitSetSetOff(bitset_t *set, size_t index)
+{
+	assert(set);
+	assert(index < set->num_of_bits);
+
+	WORD(set, index) &= ~BIT_MASK(index);
+}
+
+void BitSetSetBit(bitset_t *set, size_t index, int value)
+{
+	assert(value == 1 || value == 0);
+
+	if (1 == value)
+	{
+		BitSetSetOn(set, index);
+	}
+	else
+	{
+		BitSetSetOff(set, index);
+	}
+}
+
+void BitSetFlipBit(bitset_t *set, size_t index)
+{
+	assert(set);
+	assert(index < set->num_of_bits);
+
+	WORD(set, index) ^= BIT_MASK(index);
+}
+
+/*
+* receives a bitset and a starting index.
+* returns the index of the first bit at or after from that is on, or the set
+* size if there is none.
+* O(distance / LENGTH), skipping whole zero words with one test each.
+*/
+size_t BitSetFindNextOn(const bitset_t *set, size_t from)
+{
+	size_t word = 0;
+	unsigned long bits = 0;
+
+	assert(set);
+
+	if (from >= set->num_of_bits)
+	{
+		return set->num_of_bits;
+	}
+
+	word = WORD_INDEX(from);
+	bits = set->words[word] & (~0UL << BIT_OFFSET(from));
+	while (0 == bits)
+	{
+		++word;
+		if (word == set->num_of_words)
+		{
+			return set->num_of_bits;
+		}
+
+		bits = set->words[word];
+	}
+
+	return (word * LENGTH + BitsArrayFindFirstOn(bits));
+}
+
+/*
+* receives a bitset and a starting index.
+* returns the index of the first bit at or after from that is off, or the
+* set size if there is none.
+* O(distance / LENGTH).
+*/
+size_t BitSetFindNextOff(const bitset_t *set, size_t from)
+{
+	size_t word = 0;
+	unsigned long bits = 0;
+
+	assert(set);
+
+	if (from >= set->num_of_bits)
+	{
+		return set->num_of_bits;
+	}
+
+	word = WORD_INDEX(from);
+	bits = ~set->words[word] & (~0UL << BIT_OFFSET(from));
+	while (0 == bits)
+	{
+		++word;
+		if (word == set->num_of_words)
+		{
+			return set->num_of_bits;
+		}
+
+		bits = ~set->words[word];
+	}
+
+	word = word * LENGTH + BitsArrayFindFirstOn(bits);
+
+	return (word < set->num_of_bits ? word : set->num_of_bits);
+}
+
+/*
+* receives a bitset and a starting index.
+* returns the index of the last bit at or before from that is on, or the
+* set size if there is none.
+* O(distance / LENGTH).
+*/
+size_t BitSetFindPrevOn(const bitset_t *set, size_t from)
+{
+	size_t word = 0;
+	unsigned long bits = 0;
+
+	assert(set);
+	assert(from < set->num_of_bits);
+
+	word = WORD_INDEX(from);
+	bits = set->words[word] & (~0UL >> (LENGTH - 1 - BIT_OFFSET(from)));
+	while (0 == bits)
+	{
+		if (0 == word)
+		{
+			return set->num_of_bits;
+		}
+
+		--word;
+		bits = set->words[word];
+	}
+
+	return (word * LENGTH + BitsArrayFindLastOn(bits));
+}
+
+size_t BitSetFindFirstOn(const bitset_t *set)
+{
+	return BitSetFindNextOn(set, 0);
+}
+
+/*
+* receives a bitset, an action function and a param.
+* calls the action with the index of every bit that is on, in ascending
+* order, stopping at the first non-zero result.
+* returns the last action result.
+* O(n / LENGTH + bits on).
+*/
+int BitSetForEachOn(const bitset_t *set, bitset_act_func_t action,
+																void *param)
+{
+	unsigned long bits = 0;
+	size_t word = 0;
+	int res = 0;
+
+	assert(set);
+	assert(action);
+
+	for (word = 0; word < set->num_of_words && 0 == res; ++word)
+	{
+		for (bits = set->words[word]; bits && 0 == res; bits &= bits - 1)
+		{
+			res = action(word * LENGTH + BitsArrayFindFirstOn(bits), param);
+		}
+	}
+
+	return res;
+}
+
+/*
+* receives a bitset and turns every bit on.
+* O(n).
+*/
+void BitSetSetAll(bitset_t *set)
+{
+	assert(set);
+
+	memset(set->words, 0xff, set->num_of_words * sizeof(unsigned long));
+	ClearTail(set);
+}
+
+/*
+* receives a bitset and turns every bit off.
+* O(n).
+*/
+void BitSetClearAll(bitset_t *set)
+{
+	assert(set);
+
+	memset(set->words, 0, set->num_of_words * sizeof(unsigned long));
+}
+
+/*
+* receives a bitset and flips every bit.
+* O(n).
+*/
+void BitSetFlipAll(bitset_t *set)
+{
+	unsigned long *words = NULL;
+	size_t i = 0;
+
+	assert(set);
+
+	words = ALIGNED_WORDS(set);
+	for (i = 0; i < set->num_of_words; ++i)
+	{
+		words[i] = ~words[i];
+	}
+
+	ClearTail(set);
+}
+
+/*
+* receives a bitset and a number of shifts.
+* moves every bit towards the higher indexes, like << on a single word.
+* bits shifted past the end are lost, and the low bits are filled with 0.
+* O(n).
+*/
+void BitSetShiftL(bitset_t *set, size_t num_of_shifts)
+{
+	assert(set);
+
+	ShiftWordsL(ALIGNED_WORDS(set), set->num_of_words, num_of_shifts);
+	ClearTail(set);
+}
+
+/*
+* receives a bitset and a number of shifts.
+* moves every bit towards the lower indexes, like >> on a single word.
+* O(n).
+*/
+void BitSetShiftR(bitset_t *set, size_t num_of_shifts)
+{
+	assert(set);
+
+	ShiftWordsR(ALIGNED_WORDS(set), set->num_of_words, num_of_shifts);
+}
+
+/*
+* receives a bitset and a number of shifts (smaller than the set size).
+* rotates the bits towards the higher indexes, wrapping around the set size.
+* returns status.
+* O(n), needs a temporary copy of the words.
+*/
+int BitSetRotL(bitset_t *set, size_t num_of_shifts)
+{
+	unsigned long *wrapped = NULL;
+	size_t i = 0;
+
+	assert(set);
+	assert(num_of_shifts < set->num_of_bits);
+
+	if (0 == num_of_shifts)
+	{
+		return SUCCESS;
+	}
+
+	wrapped = malloc(set->num_of_words * sizeof(unsigned long));
+	if (NULL == wrapped)
+	{
+		return MALLOC_FAIL;
+	}
+
+	memcpy(wrapped, set->words, set->num_of_words * sizeof(unsigned long));
+	ShiftWordsR(wrapped, set->num_of_words, set->num_of_bits - num_of_shifts);
+	BitSetShiftL(set, num_of_shifts);
+
+	for (i = 0; i < set->num_of_words; ++i)
+	{
+		set->words[i] |= wrapped[i];
+	}
+
+	free(wrapped);
+
+	return SUCCESS;
+}
+
+/*
+* receives a bitset and a number of shifts (smaller than the set size).
+* rotates the bits towards the lower indexes, wrapping around the set size.
+* returns status.
+* O(n), needs a temporary copy of the words.
+*/
+int BitSetRotR(bitset_t *set, size_t num_of_shifts)
+{
+	assert(set);
+	assert(num_of_shifts < set->num_of_bits);
+
+	if (0 == num_of_shifts)
+	{
+		return SUCCESS;
+	}
+
+	return BitSetRotL(set, set->num_of_bits - num_of_shifts);
+}
+
+/*
+* receives a bitset and reverses the order of its bits, so bit i moves
+* to bit (size - 1 - i).
+* O(n).
+*/
+void BitSetMirror(bitset_t *set)
+{
+	assert(set);
+
+	BitsArrayMirrorBuffer(set->words, set->num_of_words);
+
+	/* the zero tail is now at the bottom of the lowest word */
+	ShiftWordsR(ALIGNED_WORDS(set), set->num_of_words,
+						set->num_of_words * LENGTH - set->num_of_bits);
+}
+
+/*
+* set algebra kernels. every bitset is cache line aligned and padded with
+* zero words to whole lines, and every op maps zero words to zero words,
+* so the kernels run over the full capacity with aligned loads and no tail.
+*/
+#define AND(a, b) ((a) & (b))
+#define OR(a, b) ((a) | (b))
+#define XOR(a, b) ((a) ^ (b))
+#define ANDNOT(a, b) ((a) & ~(b))
+
+#define DEFINE_SCALAR_KERNELS(name, OP) \
+static void name##Scalar(unsigned long *dest, const unsigned long *src1, \
+								const unsigned long *src2, size_t num_of_words) \
+{ \
+	size_t i = 0; \
+	for (i = 0; i < num_of_words; ++i) \
+	{ \
+		dest[i] = OP(src1[i], src2[i]); \
+	} \
+} \
+static size_t name##CountScalar(const unsigned long *src1, \
+								const unsigned long *src2, size_t num_of_words) \
+{ \
+	size_t counter = 0; \
+	size_t i = 0; \
+	for (i = 0; i < num_of_words; ++i) \
+	{ \
+		counter += BitsArrayCountOn(OP(src1[i], src2[i])); \
+	} \
+	return counter; \
+}
+
+DEFINE_SCALAR_KERNELS(And, AND)
+DEFINE_SCALAR_KERNELS(Or, OR)
+DEFINE_SCALAR_KERNELS(Xor, XOR)
+DEFINE_SCALAR_KERNELS(AndNot, ANDNOT)
+
+static op_kernel_t op_kernels[NUM_OF_OPS] =
+{
+	AndScalar, OrScalar, XorScalar, AndNotScalar
+};
+
+static op_count_kernel_t op_count_kernels[NUM_OF_OPS] =
+{
+	AndCountScalar, OrCountScalar, XorCountScalar, AndNotCountScalar
+};
+
+#ifdef X86_DISPATCH
+#define SSE2_WORDS (sizeof(__m128i) / sizeof(unsigned long))
+#define AVX2_WORDS (sizeof(__m256i) / sizeof(unsigned long))
+#define ANDNOT_SSE2(a, b) _mm_andnot_si128((b), (a))
+#define ANDNOT_AVX2(a, b) _mm256_andnot_si256((b), (a))
+
+/*SWAR popcount of each 64-bit lane using SSE2 only*/
+__attribute__((target("sse2")))
+static __m128i CountLanesSse2(__m128i v)
+{
+	const __m128i m1 = _mm_set1_epi8(0x55);
+	const __m128i m2 = _mm_set1_epi8(0x33);
+	const __m128i m4 = _mm_set1_epi8(0x0f);
+
+	v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi64(v, 1), m1));
+	v = _mm_add_epi8(_mm_and_si128(v, m2),
+									_mm_and_si128(_mm_srli_epi64(v, 2), m2));
+	v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi64(v, 4)), m4);
+
+	return _mm_sad_epu8(v, _mm_setzero_si128());
+}
+
+/*nibble shuffle popcount of each 64-bit lane*/
+__attribute__((target("avx2")))
+static __m256i CountLanesAvx2(__m256i v)
+{
+	const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+										 1, 2, 2, 3, 2, 3, 3, 4,
+										 0, 1, 1, 2, 1, 2, 2, 3,
+										 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+	__m256i low = _mm256_and_si256(v, low_mask);
+	__m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+
+	return _mm256_sad_epu8(_mm256_add_epi8(_mm256_shuffle_epi8(lut, low),
+										  _mm256_shuffle_epi8(lut, high)),
+												_mm256_setzero_si256());
+}
+
+#define DEFINE_SSE2_KERNELS(name, VOP) \
+__attribute__((target("sse2"))) \
+static void name##Sse2(unsigned long *dest, const unsigned long *src1, \
+								const unsigned long *src2, size_t num_of_words) \
+{ \
+	size_t i = 0; \
+	for (i = 0; i < num_of_words; i += SSE2_WORDS) \
+	{ \
+		_mm_store_si128((__m128i *)(dest + i), \
+			VOP(_mm_load_si128((const __m128i *)(src1 + i)), \
+				_mm_load_si128((const __m128i *)(src2 + i)))); \
+	} \
+} \
+__attribute__((target("sse2"))) \
+static size_t name##CountSse2(const unsigned long *src1, \
+								const unsigned long *src2, size_t num_of_words) \
+{ \
+	__m128i total = _mm_setzero_si128(); \
+	size_t i = 0; \
+	for (i = 0; i < num_of_words; i += SSE2_WORDS) \
+	{ \
+		total = _mm_add_epi64(total, CountLanesSse2( \
+			VOP(_mm_load_si128((const __m128i *)(src1 + i)), \
+				_mm_load_si128((const __m128i *)(src2 + i))))); \
+	} \
+	return ((size_t)_mm_cvtsi128_si64(total) + \
+			(size_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total))); \
+}
+
+#define DEFINE_AVX2_KERNELS(name, VOP) \
+__attribute__((target("avx2"))) \
+static void name##Avx2(unsigned long *dest, const unsigned long *src1, \
+								const unsigned long *src2, size_t num_of_words) \
+{ \
+	size_t i = 0; \
+	for (i = 0; i < num_of_words; i += AVX2_WORDS) \
+	{ \
+		_mm256_store_si256((__m256i *)(dest + i), \
+			VOP(_mm256_load_si256((const __m256i *)(src1 + i)), \
+				_mm256_load_si256((const __m256i *)(src2 + i)))); \
+	} \
+} \
+__attribute__((target("avx2"))) \
+static size_t name##CountAvx2(const unsigned long *src1, \
+								const unsigned long *src2, size_t num_of_words) \
+{ \
+	__m256i total = _mm256_setzero_si256(); \
+	__m128i half; \
+	size_t i = 0; \
+	for (i = 0; i < num_of_words; i += AVX2_WORDS) \
+	{ \
+		total = _mm256_add_epi64(total, CountLanesAvx2( \
+			VOP(_mm256_load_si256((const __m256i *)(src1 + i)), \
+				_mm256_load_si256((const __m256i *)(src2 + i))))); \
+	} \
+	half = _mm_add_epi64(_mm256_castsi256_si128(total), \
+									_mm256_extracti128_si256(total, 1)); \
+	return ((size_t)_mm_cvtsi128_si64(half) + \
+			(size_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(half, half))); \
+}
+
+DEFINE_SSE2_KERNELS(And, _mm_and_si128)
+DEFINE_SSE2_KERNELS(Or, _mm_or_si128)
+DEFINE_SSE2_KERNELS(Xor, _mm_xor_si128)
+DEFINE_SSE2_KERNELS(AndNot, ANDNOT_SSE2)
+DEFINE_AVX2_KERNELS(And, _mm256_and_si256)
+DEFINE_AVX2_KERNELS(Or, _mm256_or_si256)
+DEFINE_AVX2_KERNELS(Xor, _mm256_xor_si256)
+DEFINE_AVX2_KERNELS(AndNot, ANDNOT_AVX2)
+
+/*picks the set algebra kernels once at load time*/
+__attribute__((constructor))
+static void PickOpKernels(void)
+{
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+	{
+		op_kernels[OP_AND] = AndAvx2;
+		op_kernels[OP_OR] = OrAvx2;
+		op_kernels[OP_XOR] = XorAvx2;
+		op_kernels[OP_ANDNOT] = AndNotAvx2;
+		op_count_kernels[OP_AND] = AndCountAvx2;
+		op_count_kernels[OP_OR] = OrCountAvx2;
+		op_count_kernels[OP_XOR] = XorCountAvx2;
+		op_count_kernels[OP_ANDNOT] = AndNotCountAvx2;
+	}
+	else if (__builtin_cpu_supports("sse2"))
+	{
+		op_kernels[OP_AND] = AndSse2;
+		op_kernels[OP_OR] = OrSse2;
+		op_kernels[OP_XOR] = XorSse2;
+		op_kernels[OP_ANDNOT] = AndNotSse2;
+		op_count_kernels[OP_AND] = AndCountSse2;
+		op_count_kernels[OP_OR] = OrCountSse2;
+		op_count_kernels[OP_XOR] = XorCountSse2;
+		op_count_kernels[OP_ANDNOT] = AndNotCountSse2;
+	}
+}
+#endif
+
+static void ApplyOp(bitset_t *dest, const bitset_t *src1,
+									const bitset_t *src2, enum set_op op)
+{
+	assert(dest);
+	assert(src1);
+	assert(src2);
+	assert(dest->num_of_bits == src1->num_of_bits);
+	assert(dest->num_of_bits == src2->num_of_bits);
+
+	op_kernels[op](ALIGNED_WORDS(dest), ALIGNED_WORDS(src1),
+										ALIGNED_WORDS(src2), dest->capacity);
+}
+
+static size_t CountOp(const bitset_t *src1, const bitset_t *src2,
+															enum set_op op)
+{
+	assert(src1);
+	assert(src2);
+	assert(src1->num_of_bits == src2->num_of_bits);
+
+	return op_count_kernels[op](ALIGNED_WORDS(src1), ALIGNED_WORDS(src2),
+															src1->capacity);
+}
+
+/*
+* receives a destination bitset and two sources of the same size.
+* dest may be one of the sources.
+* stores src1 & src2 (|, ^, & ~ for the other ops) in dest.
+* O(n), vectorized with AVX2 or SSE2 when the cpu supports it.
+*/
+void BitSetAnd(bitset_t *dest, const bitset_t *src1, const bitset_t *src2)
+{
+	ApplyOp(dest, src1, src2, OP_AND);
+}
+
+void BitSetOr(bitset_t *dest, const bitset_t *src1, const bitset_t *src2)
+{
+	ApplyOp(dest, src1, src2, OP_OR);
+}
+
+void BitSetXor(bitset_t *dest, const bitset_t *src1, const bitset_t *src2)
+{
+	ApplyOp(dest, src1, src2, OP_XOR);
+}
+
+void BitSetAndNot(bitset_t *dest, const bitset_t *src1, const bitset_t *src2)
+{
+	ApplyOp(dest, src1, src2, OP_ANDNOT);
+}
+
+/*
+* receives two bitsets of the same size.
+* returns the number of bits on in src1 & src2 (|, ^, & ~ for the other ops)
+* without writing the result anywhere, in one pass over both sources.
+* O(n), vectorized with AVX2 or SSE2 when the cpu supports it.
+*/
+size_t BitSetAndCount(const bitset_t *src1, const bitset_t *src2)
+{
+	return CountOp(src1, src2, OP_AND);
+}
+
+size_t BitSetOrCount(const bitset_t *src1, const bitset_t *src2)
+{
+	return CountOp(src1, src2, OP_OR);
+}
+
+size_t BitSetXorCount(const bitset_t *src1, const bitset_t *src2)
+{
+	return CountOp(src1, src2, OP_XOR);
+}
+
+size_t BitSetAndNotCount(const bitset_t *src1, const bitset_t *src2)
+{
+	return CountOp(src1, src2, OP_ANDNOT);
+}
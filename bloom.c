@@ -0,0 +1,410 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "barr.h"
+#include "bitset.h"
+#include "hash_table.h"
+#include "bloom.h"
+
+/*
+* blocked bloom filters: every element maps to one 64 byte block (one cache
+* line, 8 words) and sets one bit in each of its 8 words, so a lookup costs
+* a single cache miss. the 8 bit positions come from multiplying one 32-bit
+* hash by 8 odd salts and keeping the top bits, which AVX2 does in one go.
+*
+* the counting variant keeps the same layout with 4-bit counters (16 per
+* word) instead of bits, so elements can be removed. a counter that reaches
+* 15 sticks there, since its true count is no longer known.
+*/
+#define WORDS_PER_BLOCK 8
+#define BITS_PER_BLOCK (WORDS_PER_BLOCK * LENGTH)
+#define BIT_SHIFT 26 /*top 6 bits of the product: one of 64 bits*/
+#define COUNTER_SHIFT 28 /*top 4 bits of the product: one of 16 counters*/
+#define COUNTER_BITS 4
+#define COUNTER_MAX 15UL
+#define DIV_ROUND_UP(a, b) (((a) + (b) - 1) / (b))
+#define BLOCK(words, hash, num_of_blocks) \
+	((words) + BlockIndex((hash), (num_of_blocks)) * WORDS_PER_BLOCK)
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+struct bloom_t
+{
+	size_t num_of_blocks;
+	hash_func_t hash_func;
+	void *param;
+	bitset_t *bits;
+};
+
+struct counting_bloom_t
+{
+	size_t num_of_blocks;
+	hash_func_t hash_func;
+	void *param;
+	bitset_t *counters;
+};
+
+typedef void (*block_add_func_t)(unsigned long *block, unsigned int key);
+typedef int (*block_test_func_t)(const unsigned long *block, unsigned int key);
+
+static const unsigned int salts[WORDS_PER_BLOCK] =
+{
+	0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+	0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+/*
+* the user hash may be narrow (e.g. a bucket index), so it goes through the
+* splitmix64 finalizer before being split into block index and probe key.
+*/
+static unsigned long Mix(unsigned long hash)
+{
+	hash ^= hash >> 30;
+	hash *= 0xbf58476d1ce4e5b9UL;
+	hash ^= hash >> 27;
+	hash *= 0x94d049bb133111ebUL;
+	hash ^= hash >> 31;
+
+	return hash;
+}
+
+static size_t BlockIndex(unsigned long hash, size_t num_of_blocks)
+{
+	return (size_t)(((hash >> 32) * num_of_blocks) >> 32);
+}
+
+static size_t Probe(unsigned int key, size_t word, size_t shift)
+{
+	return ((unsigned int)(key * salts[word]) >> shift);
+}
+
+static void BlockAddScalar(unsigned long *block, unsigned int key)
+{
+	size_t i = 0;
+
+	for (i = 0; i < WORDS_PER_BLOCK; ++i)
+	{
+		block[i] |= 1UL << Probe(key, i, BIT_SHIFT);
+	}
+}
+
+static int BlockTestScalar(const unsigned long *block, unsigned int key)
+{
+	unsigned long missing = 0;
+	size_t i = 0;
+
+	for (i = 0; i < WORDS_PER_BLOCK; ++i)
+	{
+		missing |= ~block[i] & (1UL << Probe(key, i, BIT_SHIFT));
+	}
+
+	return (0 == missing);
+}
+
+static block_add_func_t block_add = BlockAddScalar;
+static block_test_func_t block_test = BlockTestScalar;
+
+#ifdef X86_DISPATCH
+/*the 8 probe masks of a key, as the two 256-bit halves of its block*/
+__attribute__((target("avx2")))
+static void ProbeMasksAvx2(unsigned int key, __m256i *low, __m256i *high)
+{
+	__m256i products = _mm256_mullo_epi32(_mm256_set1_epi32((int)key),
+						_mm256_loadu_si256((const __m256i *)salts));
+	__m256i shifts = _mm256_srli_epi32(products, BIT_SHIFT);
+	__m256i ones = _mm256_set1_epi64x(1);
+
+	*low = _mm256_sllv_epi64(ones,
+						_mm256_cvtepu32_epi64(_mm256_castsi256_si128(shifts)));
+	*high = _mm256_sllv_epi64(ones,
+						_mm256_cvtepu32_epi64(_mm256_extracti128_si256(shifts, 1)));
+}
+
+__attribute__((target("avx2")))
+static void BlockAddAvx2(unsigned long *block, unsigned int key)
+{
+	__m256i low, high;
+	__m256i *halves = (__m256i *)block;
+
+	ProbeMasksAvx2(key, &low, &high);
+	_mm256_store_si256(halves, _mm256_or_si256(_mm256_load_si256(halves), low));
+	_mm256_store_si256(halves + 1,
+						_mm256_or_si256(_mm256_load_si256(halves + 1), high));
+}
+
+__attribute__((target("avx2")))
+static int BlockTestAvx2(const unsigned long *block, unsigned int key)
+{
+	__m256i low, high;
+	const __m256i *halves = (const __m256i *)block;
+
+	ProbeMasksAvx2(key, &low, &high);
+
+	return (_mm256_testc_si256(_mm256_load_si256(halves), low) &
+			_mm256_testc_si256(_mm256_load_si256(halves + 1), high));
+}
+
+/*picks the block kernels once at load time*/
+__attribute__((constructor))
+static void PickBlockKernels(void)
+{
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+	{
+		block_add = BlockAddAvx2;
+		block_test = BlockTestAvx2;
+	}
+}
+#endif
+
+/*
+* receives the number of bits to use, a hash function and its param (the
+* same hash_func_t the hash table takes; wider hash values spread better).
+* creates an empty blocked bloom filter, rounded up to whole 512-bit blocks.
+* about 10 bits per expected element give a ~1% false positive rate.
+* returns the filter if succeeded, NULL otherwise.
+* O(n).
+*/
+bloom_t *BloomCreate(size_t num_of_bits, hash_func_t hash_func, void *param)
+{
+	bloom_t *bloom = NULL;
+
+	assert(0 < num_of_bits);
+	assert(NULL != hash_func);
+
+	bloom = malloc(sizeof(bloom_t));
+	if (NULL == bloom)
+	{
+		return NULL;
+	}
+
+	bloom->num_of_blocks = DIV_ROUND_UP(num_of_bits, BITS_PER_BLOCK);
+	bloom->bits = BitSetCreate(bloom->num_of_blocks * BITS_PER_BLOCK);
+	if (NULL == bloom->bits)
+	{
+		free(bloom);
+
+		return NULL;
+	}
+
+	bloom->hash_func = hash_func;
+	bloom->param = param;
+
+	return bloom;
+}
+
+void BloomDestroy(bloom_t *bloom)
+{
+	assert(bloom);
+
+	BitSetDestroy(bloom->bits);
+	free(bloom);
+}
+
+/*
+* receives a filter and a data.
+* records the data in the filter.
+* O(1), one cache line.
+*/
+void BloomAdd(bloom_t *bloom, const void *data)
+{
+	unsigned long hash = 0;
+
+	assert(bloom);
+
+	hash = Mix((unsigned long)bloom->hash_func((void *)data, bloom->param));
+	block_add(BLOCK(BitSetData(bloom->bits), hash, bloom->num_of_blocks),
+														(unsigned int)hash);
+}
+
+/*
+* receives a filter and a data.
+* returns 0 if the data was certainly never added, 1 if it may have been.
+* O(1), one cache line.
+*/
+int BloomMayContain(const bloom_t *bloom, const void *data)
+{
+	unsigned long hash = 0;
+
+	assert(bloom);
+
+	hash = Mix((unsigned long)bloom->hash_func((void *)data, bloom->param));
+
+	return block_test(BLOCK(BitSetData(bloom->bits), hash,
+									bloom->num_of_blocks), (unsigned int)hash);
+}
+
+/*
+* receives a filter and empties it.
+* O(n).
+*/
+void BloomClear(bloom_t *bloom)
+{
+	assert(bloom);
+
+	BitSetClearAll(bloom->bits);
+}
+
+/*
+* receives a filter.
+* returns the share of bits that are on, in thousandths. the false positive
+* rate is roughly this share to the 8th power.
+* O(n).
+*/
+size_t BloomFillPerMille(const bloom_t *bloom)
+{
+	assert(bloom);
+
+	return (BitSetCountOn(bloom->bits) * 1000 / BitSetSize(bloom->bits));
+}
+
+/****************************** counting filter *****************************/
+
+static unsigned long CounterAt(const unsigned long *block, size_t word,
+																size_t counter)
+{
+	return ((block[word] >> (counter * COUNTER_BITS)) & COUNTER_MAX);
+}
+
+/*
+* receives the number of counters to use, a hash function and its param.
+* creates an empty counting bloom filter, rounded up to whole 128-counter
+* blocks. it takes 4 times the memory of a plain filter with as many slots.
+* returns the filter if succeeded, NULL otherwise.
+* O(n).
+*/
+counting_bloom_t *CountingBloomCreate(size_t num_of_counters,
+									hash_func_t hash_func, void *param)
+{
+	counting_bloom_t *bloom = NULL;
+
+	assert(0 < num_of_counters);
+	assert(NULL != hash_func);
+
+	bloom = malloc(sizeof(counting_bloom_t));
+	if (NULL == bloom)
+	{
+		return NULL;
+	}
+
+	bloom->num_of_blocks = DIV_ROUND_UP(num_of_counters * COUNTER_BITS,
+															BITS_PER_BLOCK);
+	bloom->counters = BitSetCreate(bloom->num_of_blocks * BITS_PER_BLOCK);
+	if (NULL == bloom->counters)
+	{
+		free(bloom);
+
+		return NULL;
+	}
+
+	bloom->hash_func = hash_func;
+	bloom->param = param;
+
+	return bloom;
+}
+
+void CountingBloomDestroy(counting_bloom_t *bloom)
+{
+	assert(bloom);
+
+	BitSetDestroy(bloom->counters);
+	free(bloom);
+}
+
+static unsigned long *CountingBlock(const counting_bloom_t *bloom,
+										const void *data, unsigned int *key)
+{
+	unsigned long hash = 0;
+
+	hash = Mix((unsigned long)bloom->hash_func((void *)data, bloom->param));
+	*key = (unsigned int)hash;
+
+	return BLOCK(BitSetData(bloom->counters), hash, bloom->num_of_blocks);
+}
+
+/*
+* receives a counting filter and a data.
+* records the data in the filter.
+* O(1), one cache line.
+*/
+void CountingBloomAdd(counting_bloom_t *bloom, const void *data)
+{
+	unsigned long *block = NULL;
+	unsigned int key = 0;
+	size_t i = 0, counter = 0;
+
+	assert(bloom);
+
+	block = CountingBlock(bloom, data, &key);
+	for (i = 0; i < WORDS_PER_BLOCK; ++i)
+	{
+		counter = Probe(key, i, COUNTER_SHIFT);
+		if (COUNTER_MAX != CounterAt(block, i, counter))
+		{
+			block[i] += 1UL << (counter * COUNTER_BITS);
+		}
+	}
+}
+
+/*
+* receives a counting filter and a data.
+* returns 0 if the data is certainly not in the filter, 1 if it may be.
+* O(1), one cache line.
+*/
+int CountingBloomMayContain(const counting_bloom_t *bloom, const void *data)
+{
+	const unsigned long *block = NULL;
+	unsigned int key = 0;
+	size_t i = 0;
+
+	assert(bloom);
+
+	block = CountingBlock(bloom, data, &key);
+	for (i = 0; i < WORDS_PER_BLOCK; ++i)
+	{
+		if (0 == CounterAt(block, i, Probe(key, i, COUNTER_SHIFT)))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/*
+* receives a counting filter and a data that was added to it.
+* removes one occurrence of the data. removing data that was never added
+* corrupts the filter, so a data the filter rules out is left alone.
+* returns 0 if the data was ruled out, 1 otherwise.
+* O(1), one cache line.
+*/
+int CountingBloomRemove(counting_bloom_t *bloom, const void *data)
+{
+	unsigned long *block = NULL;
+	unsigned int key = 0;
+	size_t i = 0, counter = 0;
+
+	assert(bloom);
+
+	if (!CountingBloomMayContain(bloom, data))
+	{
+		return 0;
+	}
+
+	block = CountingBlock(bloom, data, &key);
+	for (i = 0; i < WORDS_PER_BLOCK; ++i)
+	{
+		counter = Probe(key, i, COUNTER_SHIFT);
+		if (COUNTER_MAX != CounterAt(block, i, counter))
+		{
+			block[i] -= 1UL << (counter * COUNTER_BITS);
+		}
+	}
+
+	return 1;
+}
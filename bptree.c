@@ -0,0 +1,747 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bptree.h"
+
+/*WITHOUT USING RECURSION*/
+
+/*
+*	B+ tree of fixed size elements. every node is one NODE_BYTES block with
+*	its elements (or separators) stored side by side, so a binary search in
+*	a node touches a few neighbouring cache lines instead of one malloc'd
+*	node per level. the elements live only in the leaves, which are linked
+*	both ways for sequential scans. inner nodes hold copies of the first
+*	element of the subtree to their right as separators.
+*	every node has room for one spare element, so an insert can overfill a
+*	node before it is split.
+*/
+#define NODE_BYTES 512
+#define MIN_CAPACITY 3
+#define MAX_HEIGHT 64
+#define PARAM tree->param
+#define ELEMENTS(node) ((char *)(node) + sizeof(bpt_node_t))
+#define ELEMENT(node, index) (ELEMENTS(node) + (index) * tree->element_size)
+#define CHILDREN(node) ((bpt_node_t **)(ELEMENTS(node) + tree->children_offset))
+#define CHILD(node, index) CHILDREN(node)[index]
+#define COMPARE(data1, data2) tree->cmp_func((data1), (data2), PARAM)
+#define CAPACITY(node) \
+	((node)->is_leaf ? tree->leaf_capacity : tree->inner_capacity)
+#define MIN_COUNT(node) (CAPACITY(node) / 2)
+#define MAX(a,b) (((a)>(b))? (a):(b))
+
+enum return_status
+{
+	SUCCESS,
+	MALLOC_FAIL,
+	DUPLICATE,
+	NOT_FOUND
+};
+
+typedef struct bpt_node_t bpt_node_t;
+
+struct bpt_node_t
+{
+	size_t count; /*elements in a leaf, separators in an inner node*/
+	int is_leaf;
+	bpt_node_t *next; /*leaves only*/
+	bpt_node_t *prev; /*leaves only*/
+};
+
+struct bp_tree_t
+{
+	bpt_node_t *root;
+	size_t num_of_elements;
+	size_t element_size;
+	size_t leaf_capacity;
+	size_t inner_capacity;
+	size_t children_offset;
+	compare_func_t cmp_func;
+	void *param;
+};
+
+/*the nodes from the root down to a leaf, and the child taken at each*/
+typedef struct path_t
+{
+	bpt_node_t *node[MAX_HEIGHT];
+	size_t index[MAX_HEIGHT];
+	size_t depth;
+} path_t;
+
+/*
+*	This function creates an empty B+ tree of elements of element_size
+*	bytes. elements are copied in, and compared with cmp_func.
+*	Arguments - element size, comparator, user parameters.
+*	Return value - B+ tree handle, NULL on failure.
+*/
+bp_tree_t *BptCreate(size_t element_size, compare_func_t cmp_func,
+																void *param)
+{
+	bp_tree_t *tree = NULL;
+	size_t room = NODE_BYTES - sizeof(bpt_node_t);
+
+	assert(0 < element_size);
+	assert(cmp_func);
+
+	tree = malloc(sizeof(bp_tree_t));
+	if (NULL == tree)
+	{
+		return NULL;
+	}
+
+	tree->root = NULL;
+	tree->num_of_elements = 0;
+	tree->element_size = element_size;
+	tree->cmp_func = cmp_func;
+	PARAM = param;
+
+	tree->leaf_capacity = MAX(room / element_size, MIN_CAPACITY + 1) - 1;
+	tree->inner_capacity = MAX((room - 2 * sizeof(bpt_node_t *)) /
+				(element_size + sizeof(bpt_node_t *)), MIN_CAPACITY + 1) - 1;
+	tree->children_offset = (tree->inner_capacity + 1) * element_size;
+	tree->children_offset = (tree->children_offset + sizeof(void *) - 1) /
+											sizeof(void *) * sizeof(void *);
+
+	return tree;
+}
+
+static bpt_node_t *CreateNode(bp_tree_t *tree, int is_leaf)
+{
+	bpt_node_t *node = NULL;
+
+	if (is_leaf)
+	{
+		node = malloc(sizeof(bpt_node_t) +
+							(tree->leaf_capacity + 1) * tree->element_size);
+	}
+	else
+	{
+		node = malloc(sizeof(bpt_node_t) + tree->children_offset +
+							(tree->inner_capacity + 2) * sizeof(bpt_node_t *));
+	}
+
+	if (NULL == node)
+	{
+		return NULL;
+	}
+
+	node->count = 0;
+	node->is_leaf = is_leaf;
+	node->next = NULL;
+	node->prev = NULL;
+
+	return node;
+}
+
+/*
+*	This function frees the tree and all of its nodes.
+*	Arguments - tree handle.
+*	Return value - none.
+*/
+void BptDestroy(bp_tree_t *tree)
+{
+	path_t path;
+	bpt_node_t *node = NULL, *next = NULL;
+	size_t height = 0;
+
+	assert(tree);
+
+	if (NULL == tree->root)
+	{
+		free(tree);
+
+		return;
+	}
+
+	/*the leaves go along their chain, from the leftmost one*/
+	for (node = tree->root; !node->is_leaf; node = CHILD(node, 0))
+	{
+		++height;
+	}
+
+	while (node)
+	{
+		next = node->next;
+		free(node);
+		node = next;
+	}
+
+	/*inner nodes are freed after their inner children, depth first*/
+	path.depth = 0;
+	path.node[0] = tree->root;
+	path.index[0] = 0;
+	while (0 < height)
+	{
+		node = path.node[path.depth];
+		if (path.depth + 1 < height && path.index[path.depth] <= node->count)
+		{
+			next = CHILD(node, path.index[path.depth]);
+			++path.index[path.depth];
+			++path.depth;
+			path.node[path.depth] = next;
+			path.index[path.depth] = 0;
+		}
+		else
+		{
+			free(node);
+			if (0 == path.depth)
+			{
+				break;
+			}
+			--path.depth;
+		}
+	}
+
+	free(tree);
+}
+
+/*
+*	number of elements (or separators) in node that are <= data, i.e. the
+*	child an inner node sends data to.
+*/
+static size_t UpperBound(const bp_tree_t *tree, const bpt_node_t *node,
+															const void *data)
+{
+	size_t from = 0, to = node->count, middle = 0;
+
+	while (from < to)
+	{
+		middle = from + (to - from) / 2;
+		if (COMPARE(data, ELEMENT(node, middle)) < 0)
+		{
+			to = middle;
+		}
+		else
+		{
+			from = middle + 1;
+		}
+	}
+
+	return from;
+}
+
+/*number of elements in node that are < data*/
+static size_t LowerBound(const bp_tree_t *tree, const bpt_node_t *node,
+															const void *data)
+{
+	size_t from = 0, to = node->count, middle = 0;
+
+	while (from < to)
+	{
+		middle = from + (to - from) / 2;
+		if (COMPARE(data, ELEMENT(node, middle)) > 0)
+		{
+			from = middle + 1;
+		}
+		else
+		{
+			to = middle;
+		}
+	}
+
+	return from;
+}
+
+static bpt_node_t *Descend(const bp_tree_t *tree, const void *data,
+																path_t *path)
+{
+	bpt_node_t *node = tree->root;
+	size_t index = 0;
+
+	path->depth = 0;
+	while (!node->is_leaf)
+	{
+		index = UpperBound(tree, node, data);
+		path->node[path->depth] = node;
+		path->index[path->depth] = index;
+		++path->depth;
+		node = CHILD(node, index);
+	}
+
+	return node;
+}
+
+static void InsertElement(bp_tree_t *tree, bpt_node_t *node, size_t index,
+															const void *data)
+{
+	memmove(ELEMENT(node, index + 1), ELEMENT(node, index),
+								(node->count - index) * tree->element_size);
+	memcpy(ELEMENT(node, index), data, tree->element_size);
+	++node->count;
+}
+
+static void RemoveElement(bp_tree_t *tree, bpt_node_t *node, size_t index)
+{
+	--node->count;
+	memmove(ELEMENT(node, index), ELEMENT(node, index + 1),
+								(node->count - index) * tree->element_size);
+}
+
+/*separator goes to position index, right_child to its right*/
+static void InsertSeparator(bp_tree_t *tree, bpt_node_t *node, size_t index,
+								const void *separator, bpt_node_t *right_child)
+{
+	memmove(&CHILD(node, index + 2), &CHILD(node, index + 1),
+						(node->count - index) * sizeof(bpt_node_t *));
+	CHILD(node, index + 1) = right_child;
+	InsertElement(tree, node, index, separator);
+}
+
+/*removes separator index and the child to its right*/
+static void RemoveSeparator(bp_tree_t *tree, bpt_node_t *node, size_t index)
+{
+	memmove(&CHILD(node, index + 1), &CHILD(node, index + 2),
+						(node->count - index - 1) * sizeof(bpt_node_t *));
+	RemoveElement(tree, node, index);
+}
+
+/*
+*	splits an overfull node in two, moving its right half to the empty node
+*	right. points separator at the element to push up.
+*/
+static void Split(bp_tree_t *tree, bpt_node_t *node, bpt_node_t *right,
+														const void **separator)
+{
+	size_t middle = node->count / 2;
+
+	if (node->is_leaf)
+	{
+		right->count = node->count - middle;
+		memcpy(ELEMENTS(right), ELEMENT(node, middle),
+									right->count * tree->element_size);
+		node->count = middle;
+		*separator = ELEMENT(right, 0);
+
+		right->next = node->next;
+		right->prev = node;
+		if (node->next)
+		{
+			node->next->prev = right;
+		}
+		node->next = right;
+	}
+	else
+	{
+		/*separator middle moves up, it stays readable in node until then*/
+		right->count = node->count - middle - 1;
+		memcpy(ELEMENTS(right), ELEMENT(node, middle + 1),
+									right->count * tree->element_size);
+		memcpy(CHILDREN(right), &CHILD(node, middle + 1),
+							(right->count + 1) * sizeof(bpt_node_t *));
+		node->count = middle;
+		*separator = ELEMENT(node, middle);
+	}
+}
+
+/*
+*	This function copies an element into the tree.
+*	Arguments - tree handle, element.
+*	Return value - SUCCESS, DUPLICATE if an equal element is already in, or
+*	MALLOC_FAIL. the tree is unchanged unless SUCCESS is returned.
+*	O(log n).
+*/
+int BptInsert(bp_tree_t *tree, const void *data)
+{
+	path_t path;
+	bpt_node_t *spare[MAX_HEIGHT + 1];
+	bpt_node_t *leaf = NULL, *node = NULL, *new_root = NULL;
+	const void *separator = NULL;
+	size_t index = 0, num_of_spares = 0, depth = 0, i = 0;
+	int malloc_failed = 0;
+
+	assert(tree);
+	assert(data);
+
+	if (NULL == tree->root)
+	{
+		tree->root = CreateNode(tree, 1);
+		if (NULL == tree->root)
+		{
+			return MALLOC_FAIL;
+		}
+	}
+
+	leaf = Descend(tree, data, &path);
+	index = LowerBound(tree, leaf, data);
+	if (index < leaf->count && 0 == COMPARE(data, ELEMENT(leaf, index)))
+	{
+		return DUPLICATE;
+	}
+
+	/*every full node on the way up splits: allocate them all up front*/
+	node = leaf;
+	for (depth = path.depth; node->count == CAPACITY(node); --depth)
+	{
+		spare[num_of_spares] = CreateNode(tree, node->is_leaf);
+		malloc_failed |= (NULL == spare[num_of_spares]);
+		++num_of_spares;
+		if (0 == depth)
+		{
+			spare[num_of_spares] = CreateNode(tree, 0);
+			malloc_failed |= (NULL == spare[num_of_spares]);
+			++num_of_spares;
+			break;
+		}
+
+		node = path.node[depth - 1];
+	}
+
+	if (malloc_failed)
+	{
+		while (0 < num_of_spares)
+		{
+			--num_of_spares;
+			free(spare[num_of_spares]);
+		}
+
+		return MALLOC_FAIL;
+	}
+
+	node = leaf;
+	InsertElement(tree, node, index, data);
+	++tree->num_of_elements;
+
+	for (i = 0; node->count > CAPACITY(node); ++i)
+	{
+		Split(tree, node, spare[i], &separator);
+
+		if (0 == path.depth)
+		{
+			new_root = spare[i + 1];
+			CHILD(new_root, 0) = node;
+			InsertSeparator(tree, new_root, 0, separator, spare[i]);
+			tree->root = new_root;
+			break;
+		}
+
+		--path.depth;
+		node = path.node[path.depth];
+		InsertSeparator(tree, node, path.index[path.depth], separator,
+																	spare[i]);
+	}
+
+	return SUCCESS;
+}
+
+/*moves one element or separator from sibling into node through parent*/
+static void Borrow(bp_tree_t *tree, bpt_node_t *parent, size_t index,
+												bpt_node_t *node, int from_left)
+{
+	bpt_node_t *sibling = NULL;
+
+	if (from_left)
+	{
+		sibling = CHILD(parent, index - 1);
+		if (node->is_leaf)
+		{
+			InsertElement(tree, node, 0, ELEMENT(sibling, sibling->count - 1));
+			memcpy(ELEMENT(parent, index - 1), ELEMENT(node, 0),
+														tree->element_size);
+		}
+		else
+		{
+			memmove(&CHILD(node, 1), &CHILD(node, 0),
+								(node->count + 1) * sizeof(bpt_node_t *));
+			CHILD(node, 0) = CHILD(sibling, sibling->count);
+			InsertElement(tree, node, 0, ELEMENT(parent, index - 1));
+			memcpy(ELEMENT(parent, index - 1),
+				ELEMENT(sibling, sibling->count - 1), tree->element_size);
+		}
+
+		--sibling->count;
+	}
+	else
+	{
+		sibling = CHILD(parent, index + 1);
+		if (node->is_leaf)
+		{
+			InsertElement(tree, node, node->count, ELEMENT(sibling, 0));
+			RemoveElement(tree, sibling, 0);
+			memcpy(ELEMENT(parent, index), ELEMENT(sibling, 0),
+														tree->element_size);
+		}
+		else
+		{
+			CHILD(node, node->count + 1) = CHILD(sibling, 0);
+			InsertElement(tree, node, node->count, ELEMENT(parent, index));
+			memcpy(ELEMENT(parent, index), ELEMENT(sibling, 0),
+														tree->element_size);
+			memmove(&CHILD(sibling, 0), &CHILD(sibling, 1),
+								sibling->count * sizeof(bpt_node_t *));
+			RemoveElement(tree, sibling, 0);
+		}
+	}
+}
+
+/*merges child index + 1 of parent into child index and frees it*/
+static void Merge(bp_tree_t *tree, bpt_node_t *parent, size_t index)
+{
+	bpt_node_t *left = CHILD(parent, index);
+	bpt_node_t *right = CHILD(parent, index + 1);
+
+	if (left->is_leaf)
+	{
+		left->next = right->next;
+		if (right->next)
+		{
+			right->next->prev = left;
+		}
+	}
+	else
+	{
+		InsertElement(tree, left, left->count, ELEMENT(parent, index));
+		memcpy(&CHILD(left, left->count), CHILDREN(right),
+							(right->count + 1) * sizeof(bpt_node_t *));
+	}
+
+	memcpy(ELEMENT(left, left->count), ELEMENTS(right),
+									right->count * tree->element_size);
+	left->count += right->count;
+	free(right);
+
+	RemoveSeparator(tree, parent, index);
+}
+
+/*
+*	This function removes the element equal to data.
+*	Arguments - tree handle, key.
+*	Return value - SUCCESS or NOT_FOUND.
+*	O(log n).
+*/
+int BptRemove(bp_tree_t *tree, const void *data)
+{
+	path_t path;
+	bpt_node_t *node = NULL, *parent = NULL;
+	size_t index = 0;
+
+	assert(tree);
+	assert(data);
+
+	if (NULL == tree->root)
+	{
+		return NOT_FOUND;
+	}
+
+	node = Descend(tree, data, &path);
+	index = LowerBound(tree, node, data);
+	if (index == node->count || 0 != COMPARE(data, ELEMENT(node, index)))
+	{
+		return NOT_FOUND;
+	}
+
+	RemoveElement(tree, node, index);
+	--tree->num_of_elements;
+
+	while (0 < path.depth && node->count < MIN_COUNT(node))
+	{
+		--path.depth;
+		parent = path.node[path.depth];
+		index = path.index[path.depth];
+
+		if (0 < index && CHILD(parent, index - 1)->count > MIN_COUNT(node))
+		{
+			Borrow(tree, parent, index, node, 1);
+		}
+		else if (index < parent->count &&
+				CHILD(parent, index + 1)->count > MIN_COUNT(node))
+		{
+			Borrow(tree, parent, index, node, 0);
+		}
+		else
+		{
+			Merge(tree, parent, (0 < index) ? index - 1 : index);
+		}
+
+		node = parent;
+	}
+
+	if (0 == tree->root->count)
+	{
+		node = tree->root;
+		tree->root = node->is_leaf ? NULL : CHILD(node, 0);
+		free(node);
+	}
+
+	return SUCCESS;
+}
+
+static bpt_iter_t MakeIter(bp_tree_t *tree, bpt_node_t *leaf, size_t index)
+{
+	bpt_iter_t iter;
+
+	iter.tree = tree;
+	iter.leaf = leaf;
+	iter.index = index;
+
+	return iter;
+}
+
+/*
+*	This function finds the element equal to data.
+*	Arguments - tree handle, key.
+*	Return value - iterator to the element, or BptEnd if there is none.
+*	O(log n), one node (a few neighbouring cache lines) per level.
+*/
+bpt_iter_t BptFind(bp_tree_t *tree, const void *data)
+{
+	path_t path;
+	bpt_node_t *leaf = NULL;
+	size_t index = 0;
+
+	assert(tree);
+
+	if (NULL == tree->root)
+	{
+		return BptEnd(tree);
+	}
+
+	leaf = Descend(tree, data, &path);
+	index = LowerBound(tree, leaf, data);
+	if (index == leaf->count || 0 != COMPARE(data, ELEMENT(leaf, index)))
+	{
+		return BptEnd(tree);
+	}
+
+	return MakeIter(tree, leaf, index);
+}
+
+size_t BptCount(const bp_tree_t *tree)
+{
+	assert(tree);
+
+	return tree->num_of_elements;
+}
+
+int BptIsEmpty(const bp_tree_t *tree)
+{
+	assert(tree);
+
+	return (0 == tree->num_of_elements);
+}
+
+bpt_iter_t BptBegin(bp_tree_t *tree)
+{
+	bpt_node_t *node = NULL;
+
+	assert(tree);
+
+	node = tree->root;
+	if (NULL == node)
+	{
+		return BptEnd(tree);
+	}
+
+	while (!node->is_leaf)
+	{
+		node = CHILD(node, 0);
+	}
+
+	return MakeIter(tree, node, 0);
+}
+
+bpt_iter_t BptEnd(bp_tree_t *tree)
+{
+	assert(tree);
+
+	return MakeIter(tree, NULL, 0);
+}
+
+/*
+*	return value - next iterator.
+*	arguments - tree iterator (not BptEnd).
+*	O(1), moving along the leaf chain.
+*/
+bpt_iter_t BptNext(bpt_iter_t iter)
+{
+	bpt_node_t *leaf = iter.leaf;
+
+	assert(leaf);
+
+	if (iter.index + 1 < leaf->count)
+	{
+		++iter.index;
+
+		return iter;
+	}
+
+	return (leaf->next ? MakeIter(iter.tree, leaf->next, 0) :
+													BptEnd(iter.tree));
+}
+
+/*
+*	return value - previous iterator.
+*	arguments - tree iterator (not BptBegin). BptPrev(BptEnd) is the last
+*	element.
+*	O(1), or O(log n) from BptEnd.
+*/
+bpt_iter_t BptPrev(bpt_iter_t iter)
+{
+	bp_tree_t *tree = iter.tree;
+	bpt_node_t *leaf = iter.leaf;
+
+	if (NULL == leaf)
+	{
+		leaf = tree->root;
+		assert(leaf);
+
+		while (!leaf->is_leaf)
+		{
+			leaf = CHILD(leaf, leaf->count);
+		}
+
+		return MakeIter(tree, leaf, leaf->count - 1);
+	}
+
+	if (0 < iter.index)
+	{
+		--iter.index;
+
+		return iter;
+	}
+
+	leaf = leaf->prev;
+	assert(leaf);
+
+	return MakeIter(tree, leaf, leaf->count - 1);
+}
+
+/*
+*	return value - pointer to the element inside the tree. it stays valid
+*	until the next insert or remove.
+*	arguments - tree iterator.
+*/
+void *BptGetData(bpt_iter_t iter)
+{
+	bp_tree_t *tree = iter.tree;
+
+	assert(iter.leaf);
+
+	return ELEMENT((bpt_node_t *)iter.leaf, iter.index);
+}
+
+int BptIsSameIter(bpt_iter_t iter1, bpt_iter_t iter2)
+{
+	return (iter1.leaf == iter2.leaf &&
+			(NULL == iter1.leaf || iter1.index == iter2.index));
+}
+
+/*
+*	return value - 0 if every action succeeded, 1 if one failed.
+*	arguments - range [from, to), action function, param.
+*	this function performs the given action for each element in order.
+*/
+int BptForEach(bpt_iter_t from, bpt_iter_t to, action_func_t act_func,
+																void *param)
+{
+	int func_result = 0;
+
+	assert(act_func);
+
+	while (!BptIsSameIter(from, to) && !func_result)
+	{
+		func_result = act_func(BptGetData(from), param);
+		from = BptNext(from);
+	}
+
+	return (0 != func_result);
+}
@@ -9,35 +9,127 @@
 #define ISSMALLERCHILD(node) (PARENT(node)->child[0] == node)
 #define ISBIGGERCHILD(node) (PARENT(node)->child[1] == node)
 #define ROOT tree->root.child[0]
+#define ROOT_OF(piece) (piece)->root.child[0]
 #define NEXT(node) (tree_node_t *)BstNext((bst_iter)node)
 #define NEXTITER(iter) ((tree_node_t *)BstNext((bst_iter)iter))
 #define PREVITER(iter) ((tree_node_t *)BstPrev((bst_iter)iter))
 #define HASRIGHTCHILD(node) (node->child[1]? 1 : 0)
 #define HASLEFTCHILD(node) (node->child[0]? 1 : 0)
 #define ISLEAF(node) (!node->child[0] && !node->child[1])
-#define REWIREPARENTTOGRANDSON(target_node) \
-	PARENT(target_node)->child[ISBIGGERCHILD(target_node)] = \
-							target_node->child[HASRIGHTCHILD(target_node)]; \
-	PARENT(target_node->child[HASRIGHTCHILD(target_node)]) = \
-															PARENT(target_node);
+#define ISRED(node) ((node) && RED == (node)->color)
+#define ISBLACK(node) (!ISRED(node))
+#define SIZE(node) ((node) ? (node)->size : 0)
+#define MAX_DEPTH (sizeof(size_t) * 8)
+#define CACHE_LINE 64
+#define LINE_OF_DESCENDANTS (CACHE_LINE / sizeof(void *))
+
+#ifdef __GNUC__
+#define PREFETCH(address) __builtin_prefetch(address)
+#define TRAILING_ONES(index) ((size_t)__builtin_ctzl(~(unsigned long)(index)))
+#else
+#define PREFETCH(address)
+#define TRAILING_ONES(index) TrailingOnes(index)
+#endif
+
+enum node_color
+{
+	RED,
+	BLACK
+};
 
 
 typedef struct tree_node_t tree_node_t;
+typedef struct node_block_t node_block_t;
 
 struct tree_node_t
 {
 	tree_node_t *parent;
 	void *data;
 	tree_node_t *child[2]; /*0 = left(smaller), 1 = right (larger)*/
+	int color; /*only kept up to date in balanced trees*/
+	int is_in_block; /*allocated by BstCreateFromSorted, never freed alone*/
+	size_t size; /*nodes in this subtree, the sentinel's is the tree's*/
 };
 
 struct bs_tree_t
+{
+	tree_node_t root; /*must stay first, see TreeOfNode*/
+	compare_func_t cmp_func;
+	void *param;
+	int is_balanced;
+	node_block_t **blocks; /*blocks some of the nodes live in*/
+	size_t num_of_blocks;
+};
+
+/*
+*	the nodes of BstCreateFromSorted, allocated together. a block is freed
+*	when the last tree whose nodes came from it is destroyed, since split
+*	and the set operations move nodes between trees.
+*/
+struct node_block_t
+{
+	size_t ref_count;
+	size_t size;
+	tree_node_t *nodes;
+};
+
+/*a detached red-black subtree under a sentinel of its own*/
+typedef struct piece_t
 {
 	tree_node_t root;
+	size_t black_height; /*black nodes on a path down, the root included*/
+} piece_t;
+
+/*one pending step of a set operation: T1 op T2 split around middle*/
+typedef struct set_frame_t
+{
+	piece_t tree1;
+	piece_t tree2;
+	piece_t right1;
+	piece_t right2;
+	piece_t left_result;
+	piece_t result;
+	tree_node_t *middle;
+	tree_node_t *found;
+	int stage;
+} set_frame_t;
+
+enum set_operation
+{
+	UNION,
+	INTERSECTION,
+	DIFFERENCE
+};
+
+enum return_status
+{
+	SUCCESS,
+	MALLOC_FAIL
+};
+
+/*
+*	BstFreeze snapshot: the datas in Eytzinger (BFS) order, 1-based, so the
+*	children of position k are 2k and 2k + 1 and the top levels of every
+*	search share the first cache lines.
+*/
+struct bst_frozen_t
+{
+	void **data;
+	size_t num_of_elements;
 	compare_func_t cmp_func;
 	void *param;
 };
 
+/*a range of the sorted array that still has to become a subtree*/
+typedef struct build_range_t
+{
+	size_t from;
+	size_t to;
+	size_t depth;
+	tree_node_t *parent;
+	int side;
+} build_range_t;
+
 /*
 *	This function creates a BST where the root data is always NULL, and the
 *	first node is it's left (smaller) child.
@@ -56,351 +148,1574 @@ bs_tree_t *BstCreate(compare_func_t cmp_func, void *param)
 		tree->root.parent = NULL;
 		tree->root.data = NULL;
 		tree->root.child[1] = NULL;
+		tree->root.color = BLACK;
+		tree->root.size = 0;
 		ROOT = NULL;
 		tree->cmp_func = cmp_func;
 		PARAM = param;
+		tree->is_balanced = 0;
+		tree->blocks = NULL;
+		tree->num_of_blocks = 0;
 	}
 
 	return tree;
 }
 
 /*
-*	This function frees the allocated memory of a tree management struct.
-*	Arguments - tree management struct.
-*	Return value - none.
+*	This function creates a BST like BstCreate, that stays balanced
+*	(red-black) through inserts and removes, so its height is O(log n)
+*	whatever the insertion order.
+*	Arguements = comparator, user parameters.
+*	Return value - BStree handle.
 */
-void BstDestroy(bs_tree_t *tree)
+bs_tree_t *BstCreateBalanced(compare_func_t cmp_func, void *param)
 {
-	tree_node_t *node1 = NULL, *node2 = NULL;
-	size_t counter = 0;
-	assert(tree);
+	bs_tree_t *tree = BstCreate(cmp_func, param);
 
-	counter = BstCount(tree);
-	if (counter)
+	if (tree)
 	{
-		node1 = (tree_node_t *)BstBegin(tree);
-
-		while (counter)
-		{
-			node2 = NEXT(node1);
-			BstRemove((bst_iter)node1);
-			node1 = node2;
-			--counter;
-		}
+		tree->is_balanced = 1;
 	}
-	
-	free(tree);
-	tree = NULL;
+
+	return tree;
 }
 
-static tree_node_t *CreateNode(void *data)
+/*
+*	This function creates a balanced BST (like BstCreateBalanced) holding
+*	the count elements of data, which must already be sorted by cmp_func.
+*	the tree is height optimal and is built in O(n) without comparing
+*	anything. all of its nodes come from one allocation.
+*	Arguements = comparator, user parameters, sorted array, its length.
+*	Return value - BStree handle, NULL on failure.
+*/
+bs_tree_t *BstCreateFromSorted(compare_func_t cmp_func, void *param,
+												void **data, size_t count)
 {
+	bs_tree_t *tree = NULL;
+	build_range_t stack[MAX_DEPTH + 1];
+	build_range_t range;
+	node_block_t *block = NULL;
 	tree_node_t *node = NULL;
+	size_t top = 0, middle = 0, last_depth = 0;
 
-	node = malloc(sizeof(tree_node_t));
-	if (!node)
+	assert(data || 0 == count);
+
+	tree = BstCreateBalanced(cmp_func, param);
+	if (!tree || 0 == count)
 	{
-		return NULL;
+		return tree;
 	}
-	node->data = data;
-	node->child[0] = NULL;
-	node->child[1] = NULL;
 
-	return node;
-}
+	block = malloc(sizeof(node_block_t) + count * sizeof(tree_node_t));
+	tree->blocks = malloc(sizeof(node_block_t *));
+	if (!block || !tree->blocks)
+	{
+		free(block);
+		free(tree->blocks);
+		free(tree);
 
-/*
-*	return value - iter to the new data
-*	arguments - tree management struct, void *data to insert
-*	this function receives a tree management struct
-*	and insert a new data to it
-*/
-bst_iter BstInsert(bs_tree_t *tree, void *data)
-{
-	tree_node_t *node = NULL, *node_parent = NULL;
+		return NULL;
+	}
+	block->ref_count = 1;
+	block->size = count;
+	block->nodes = (tree_node_t *)(block + 1);
+	tree->blocks[0] = block;
+	tree->num_of_blocks = 1;
+	tree->root.size = count;
 
-	assert(tree);
-	assert(data); /*cant compare NULL*/
+	/*splitting at the middle puts every leaf on the last two levels*/
+	for (middle = count; middle > 1; middle /= 2)
+	{
+		++last_depth;
+	}
 
-	node = CreateNode(data);
-	if (!node)
+	range.from = 0;
+	range.to = count;
+	range.depth = 0;
+	range.parent = &tree->root;
+	range.side = 0;
+	stack[top++] = range;
+
+	while (top > 0)
 	{
-		return BstEnd(tree);
+		range = stack[--top];
+		middle = range.from + (range.to - range.from) / 2;
+
+		/*
+		*	red nodes on the last level keep the black heights equal whether
+		*	or not that level is full
+		*/
+		node = &block->nodes[middle];
+		node->data = data[middle];
+		node->child[0] = NULL;
+		node->child[1] = NULL;
+		node->color = (0 < range.depth && range.depth == last_depth) ?
+															RED : BLACK;
+		node->is_in_block = 1;
+		node->size = range.to - range.from;
+		PARENT(node) = range.parent;
+		range.parent->child[range.side] = node;
+
+		range.parent = node;
+		++range.depth;
+		if (middle + 1 < range.to)
+		{
+			stack[top] = range;
+			stack[top].from = middle + 1;
+			stack[top].side = 1;
+			++top;
+		}
+		if (range.from < middle)
+		{
+			stack[top] = range;
+			stack[top].to = middle;
+			stack[top].side = 0;
+			++top;
+		}
 	}
 
-	if (BstIsEmpty(tree))
+	return tree;
+}
+
+/*nodes from BstCreateFromSorted are freed with their block, not one by one*/
+static void FreeNode(tree_node_t *node)
+{
+	if (!node->is_in_block)
 	{
-		PARENT(node) = &(tree->root);
-		ROOT = node;
-		
-		return ((bst_iter)node);
+		free(node);
 	}
+}
 
-	node_parent = ROOT;
+/*lets dest free (or rather keep) nodes that came from src's blocks*/
+static int ShareBlocks(bs_tree_t *dest, const bs_tree_t *src)
+{
+	node_block_t **blocks = NULL;
+	size_t i = 0, j = 0;
 
-	while (node_parent->child[(tree->cmp_func(data, node_parent->data, PARAM) 
-																		> 0)])
+	if (0 == src->num_of_blocks)
 	{
-		node_parent = node_parent->child[tree->cmp_func(data, node_parent->data,
-																 PARAM) > 0];
+		return SUCCESS;
 	}
 
-	if (tree->cmp_func(data, node_parent->data, PARAM) > 0)
+	blocks = realloc(dest->blocks, (dest->num_of_blocks +
+							src->num_of_blocks) * sizeof(node_block_t *));
+	if (!blocks)
 	{
-		node_parent->child[1] = node;
+		return MALLOC_FAIL;
 	}
-	else
+	dest->blocks = blocks;
+
+	for (i = 0; i < src->num_of_blocks; ++i)
 	{
-		node_parent->child[0] = node;	
+		for (j = 0; j < dest->num_of_blocks &&
+								dest->blocks[j] != src->blocks[i]; ++j)
+		{
+		}
+
+		if (j == dest->num_of_blocks)
+		{
+			++src->blocks[i]->ref_count;
+			dest->blocks[dest->num_of_blocks++] = src->blocks[i];
+		}
 	}
-	
-	PARENT(node) = node_parent;
 
-	return ((bst_iter)node);
+	return SUCCESS;
 }
 
-/*
-*	return value - iter to the wanted data
-*	arguments - tree management struct, void *data to find
-*	this function receives a tree management struct
-*	and finds a given value and returns its iter
-*/
-bst_iter BstFind(bs_tree_t *tree, const void *data)
+/*hands the data to release_func, if there is one, and frees the node*/
+static void DropNode(tree_node_t *node, action_func_t release_func,
+																void *param)
 {
-	tree_node_t *node = NULL;
-
-	assert(tree);
-
-	node = ROOT;
-	while (node->child[tree->cmp_func(data, node->data, PARAM) > 0])
+	if (release_func)
 	{
-		node = node->child[tree->cmp_func(data, node->data, PARAM) > 0];
+		release_func(node->data, param);
 	}
 
-	return (tree->cmp_func(data, node->data, PARAM) ? 
-		BstEnd(tree) : (bst_iter)node);
+	FreeNode(node);
 }
 
+static void FreeNodes(tree_node_t *sentinel, action_func_t release_func,
+																void *param);
+
 /*
-*	return value - returns numbe of elements
-*	arguments - tree management struct.
-*	this function counts the number of elements in the tree.
+*	This function frees the allocated memory of a tree management struct.
+*	Arguments - tree management struct.
+*	Return value - none.
 */
-size_t BstCount(const bs_tree_t *tree)
+void BstDestroy(bs_tree_t *tree)
 {
-	tree_node_t *iterator = NULL;
-	size_t counter = 0;
-
 	assert(tree);
 
-	if (tree->root.child[0])
-	{
-		iterator = ((tree_node_t *)BstBegin((bs_tree_t *)tree));
+	FreeNodes(&tree->root, NULL, NULL);
 
-		while (iterator->data)
+	while (tree->num_of_blocks > 0)
+	{
+		--tree->num_of_blocks;
+		if (0 == --tree->blocks[tree->num_of_blocks]->ref_count)
 		{
-			iterator = NEXTITER(iterator);
-			++counter;
+			free(tree->blocks[tree->num_of_blocks]);
 		}
 	}
 
-	return counter;
+	free(tree->blocks);
+	free(tree);
+	tree = NULL;
 }
 
 /*
-*	return value - element's data
-*	arguments - tree management struct.
-*	this function removes given element.
+*	frees the nodes under sentinel bottom-up without rebalancing anything,
+*	handing each data to release_func first if there is one.
 */
-
-void *BstRemove(bst_iter iter)
+static void FreeNodes(tree_node_t *sentinel, action_func_t release_func,
+																void *param)
 {
-	tree_node_t *target_node = NULL;
-	void *data = NULL;
-	tree_node_t *left_child = NULL;
-
-	assert(iter);
-
-	target_node = (tree_node_t *)iter;
-	data = target_node->data;
+	tree_node_t *node = NULL, *parent = NULL;
 
-	if (ISLEAF(target_node))
+	node = sentinel->child[0];
+	while (node && node != sentinel)
 	{
-		PARENT(target_node)->child[ISBIGGERCHILD(target_node)] = NULL;
-	}
-	else if (!(target_node->child[0] && target_node->child[1]))
-	{
-		if (ISBIGGERCHILD(target_node))
+		if (node->child[0])
+		{
+			node = node->child[0];
+		}
+		else if (node->child[1])
 		{
-			REWIREPARENTTOGRANDSON(target_node)
+			node = node->child[1];
 		}
 		else
 		{
-			REWIREPARENTTOGRANDSON(target_node)
+			parent = PARENT(node);
+			parent->child[ISBIGGERCHILD(node)] = NULL;
+			DropNode(node, release_func, param);
+			node = parent;
 		}
 	}
-	else /* (target_node->child[0] && target_node->child[1]])*/
-	{
-		left_child = target_node->child[0];
-		PARENT(target_node)->child[ISBIGGERCHILD(target_node)] = left_child;
-		PARENT(left_child) = PARENT(target_node);
-		PARENT(target_node->child[1]) = PREVITER(target_node);
-		PREVITER(target_node)->child[1] = target_node->child[1];
-	}
 
-	free(target_node);
-	
-	return data;
+	sentinel->size = 0;
 }
 
-/*
-*	return value - success / fail.
-*	arguments - tree management struct, action function, param
-*	this function performs the given action for each element.
-*/
-int BstForEach(bst_iter from, bst_iter to, action_func_t act_func, void *param)
+static tree_node_t *CreateNode(void *data)
 {
-	tree_node_t *from_node = NULL, *to_node = NULL;
-	int func_result = 0;
-
-	assert(from);
-	assert(to);
-	assert(act_func);
-
-	from_node = (tree_node_t *)from;
-	to_node = (tree_node_t *)to;
+	tree_node_t *node = NULL;
 
-	while (from_node != to_node && !func_result)
+	node = malloc(sizeof(tree_node_t));
+	if (!node)
 	{
-		func_result = act_func(BstGetData((bst_iter)from_node), param);
-		from_node = (tree_node_t *)BstNext((bst_iter)from_node);
+		return NULL;
 	}
+	node->data = data;
+	node->child[0] = NULL;
+	node->child[1] = NULL;
+	node->color = RED;
+	node->is_in_block = 0;
+	node->size = 1;
 
-	return (from_node != to_node);
+	return node;
 }
 
 /*
-*	return value - empty/not empty.
-*	arguments - tree management struct.
-*	The function checks if the tree is empty or not.
+*	the tree handle starts with the sentinel root, whose parent is NULL,
+*	so a node can reach its tree by climbing.
 */
-int BstIsEmpty(const bs_tree_t *tree)
+static bs_tree_t *TreeOfNode(tree_node_t *node)
 {
-	assert(tree);
-	return (ROOT ? 0 : 1);
+	while (PARENT(node))
+	{
+		node = PARENT(node);
+	}
+
+	return ((bs_tree_t *)node);
 }
 
 /*
-*	return value - iterator to the first data.
-*	arguments - tree management struct.
-*	The function returns the beginning of the tree.
+*	Brings node->child[!side] up into node's place, and moves node down to
+*	its side.
 */
-bst_iter BstBegin(bs_tree_t *tree)
+static void Rotate(tree_node_t *node, int side)
 {
-	tree_node_t *node = NULL;
+	tree_node_t *pivot = node->child[!side];
 
-	assert(tree);
-
-	node = ROOT;
-	while (node->child[0])
+	node->child[!side] = pivot->child[side];
+	if (pivot->child[side])
 	{
-		node = node->child[0];
+		PARENT(pivot->child[side]) = node;
 	}
 
-	return ((bst_iter)node);
-}
+	PARENT(pivot) = PARENT(node);
+	PARENT(node)->child[ISBIGGERCHILD(node)] = pivot;
+	pivot->child[side] = node;
+	PARENT(node) = pivot;
 
-/*
-*	return value - iterator to the last data.
-*	arguments - tree management struct.
-*	The function returns the last data.
-*/
-bst_iter BstEnd(bs_tree_t *tree)
-{
-	assert(tree);
-	return ((bst_iter)&(tree->root));
+	pivot->size = node->size;
+	node->size = SIZE(node->child[0]) + SIZE(node->child[1]) + 1;
 }
 
 /*
-*	return value - next iterator.
-*	arguments - tree iteraor.
-*	The function returns the next iterator.
+*	fixes the red node under a red parent, up to the root under sentinel.
+*	returns 1 if the black height grew (the root turned red on the way).
 */
-bst_iter BstNext(bst_iter iter)
+static int InsertFixup(tree_node_t *sentinel, tree_node_t *node)
 {
-	tree_node_t *node = NULL;
-
-	assert(iter);
+	tree_node_t *parent = NULL, *grandparent = NULL, *uncle = NULL;
+	int side = 0, grew = 0;
 
-	node = (tree_node_t *)iter;
-	if (HASRIGHTCHILD(node))
+	while (ISRED(PARENT(node)))
 	{
-		node = node->child[1];
-		while (HASLEFTCHILD(node))
+		parent = PARENT(node);
+		grandparent = PARENT(parent);
+		side = ISBIGGERCHILD(parent);
+		uncle = grandparent->child[!side];
+
+		if (ISRED(uncle))
 		{
-			node = node->child[0];
+			parent->color = BLACK;
+			uncle->color = BLACK;
+			grandparent->color = RED;
+			node = grandparent;
 		}
-
-		return ((bst_iter)(node));
-	}
-	else
-	{
-		while (ISBIGGERCHILD(node))
+		else
 		{
-			node = PARENT(node);
+			if (node == parent->child[!side])
+			{
+				node = parent;
+				Rotate(node, side);
+				parent = PARENT(node);
+			}
+
+			parent->color = BLACK;
+			grandparent->color = RED;
+			Rotate(grandparent, !side);
 		}
-		
-		return ((bst_iter)PARENT(node));
 	}
+
+	grew = ISRED(sentinel->child[0]);
+	sentinel->child[0]->color = BLACK;
+
+	return grew;
 }
 
 /*
-*	return value - previous iterator.
-*	arguments - tree iteraor.
-*	The function returns the previous iterator.
+*	the child that took the removed black node's place (possibly NULL) is
+*	one black short; push the deficit up or fix it with rotations.
 */
-bst_iter BstPrev(bst_iter iter)
+static void RemoveFixup(tree_node_t *sentinel, tree_node_t *node,
+													tree_node_t *parent)
 {
-	tree_node_t *node = NULL;
-
-	assert(iter);
+	tree_node_t *sibling = NULL;
+	int side = 0;
 
-	node = (tree_node_t *)iter;
-	if (HASLEFTCHILD(node))
+	while (node != sentinel->child[0] && ISBLACK(node))
 	{
-		node = node->child[0];
-		while (HASRIGHTCHILD(node))
+		side = (parent->child[1] == node);
+		sibling = parent->child[!side];
+
+		if (ISRED(sibling))
 		{
-			node = node->child[1];
+			sibling->color = BLACK;
+			parent->color = RED;
+			Rotate(parent, side);
+			sibling = parent->child[!side];
 		}
 
-		return ((bst_iter)(node));
-	}
-	else
-	{
-		while (ISSMALLERCHILD(node))
+		if (ISBLACK(sibling->child[0]) && ISBLACK(sibling->child[1]))
 		{
-			node = PARENT(node);
+			sibling->color = RED;
+			node = parent;
+			parent = PARENT(node);
 		}
+		else
+		{
+			if (ISBLACK(sibling->child[!side]))
+			{
+				sibling->child[side]->color = BLACK;
+				sibling->color = RED;
+				Rotate(sibling, !side);
+				sibling = parent->child[!side];
+			}
 
-		return ((bst_iter)PARENT(node));
+			sibling->color = parent->color;
+			parent->color = BLACK;
+			sibling->child[!side]->color = BLACK;
+			Rotate(parent, side);
+			node = sentinel->child[0];
+		}
+	}
+
+	if (node)
+	{
+		node->color = BLACK;
+	}
+}
+
+/*adds diff to the size of node and of every node above it*/
+static void UpdateSizes(tree_node_t *node, size_t diff)
+{
+	for (; node; node = PARENT(node))
+	{
+		node->size += diff;
+	}
+}
+
+/*puts new_node (possibly NULL) in old_node's place under its parent*/
+static void Transplant(tree_node_t *old_node, tree_node_t *new_node)
+{
+	PARENT(old_node)->child[ISBIGGERCHILD(old_node)] = new_node;
+	if (new_node)
+	{
+		PARENT(new_node) = PARENT(old_node);
 	}
 }
 
 /*
-*	return value - iterator data.
+*	return value - iter to the new data
+*	arguments - tree management struct, void *data to insert
+*	this function receives a tree management struct
+*	and insert a new data to it
+*/
+bst_iter BstInsert(bs_tree_t *tree, void *data)
+{
+	tree_node_t *node = NULL, *node_parent = NULL;
+	int side = 0;
+
+	assert(tree);
+	assert(data); /*cant compare NULL*/
+
+	node = CreateNode(data);
+	if (!node)
+	{
+		return BstEnd(tree);
+	}
+
+	/*one comparison per level*/
+	node_parent = &tree->root;
+	side = 0;
+	while (node_parent->child[side])
+	{
+		node_parent = node_parent->child[side];
+		side = (tree->cmp_func(data, node_parent->data, PARAM) > 0);
+	}
+
+	node_parent->child[side] = node;
+	PARENT(node) = node_parent;
+	UpdateSizes(node_parent, 1);
+
+	if (tree->is_balanced)
+	{
+		InsertFixup(&tree->root, node);
+	}
+
+	return ((bst_iter)node);
+}
+
+/*
+*	first node whose data is > data (is_upper) or >= data (!is_upper), or
+*	the sentinel. one comparison per level.
+*/
+static tree_node_t *Bound(const bs_tree_t *tree, const void *data,
+																int is_upper)
+{
+	tree_node_t *node = NULL, *bound = NULL;
+
+	bound = (tree_node_t *)&tree->root;
+	node = ROOT;
+	while (node)
+	{
+		if (tree->cmp_func(data, node->data, PARAM) >= !is_upper)
+		{
+			node = node->child[1];
+		}
+		else
+		{
+			bound = node;
+			node = node->child[0];
+		}
+	}
+
+	return bound;
+}
+
+/*number of nodes before Bound(tree, data, is_upper)*/
+static size_t CountBelow(const bs_tree_t *tree, const void *data,
+																int is_upper)
+{
+	tree_node_t *node = NULL;
+	size_t counter = 0;
+
+	node = ROOT;
+	while (node)
+	{
+		if (tree->cmp_func(data, node->data, PARAM) >= !is_upper)
+		{
+			counter += SIZE(node->child[0]) + 1;
+			node = node->child[1];
+		}
+		else
+		{
+			node = node->child[0];
+		}
+	}
+
+	return counter;
+}
+
+/*
+*	return value - iter to the wanted data
+*	arguments - tree management struct, void *data to find
+*	this function receives a tree management struct
+*	and finds a given value and returns its iter (the first one if the tree
+*	holds several equal datas). one comparison per level, plus one.
+*/
+bst_iter BstFind(bs_tree_t *tree, const void *data)
+{
+	tree_node_t *node = NULL;
+
+	assert(tree);
+
+	node = Bound(tree, data, 0);
+
+	return ((node == &tree->root ||
+			tree->cmp_func(data, node->data, PARAM)) ? 
+		BstEnd(tree) : (bst_iter)node);
+}
+
+/*
+*	return value - iter to the first data that is not smaller than data, or
+*	BstEnd if there is none.
+*	arguments - tree management struct, void *data to compare with.
+*	one comparison per level.
+*/
+bst_iter BstLowerBound(bs_tree_t *tree, const void *data)
+{
+	assert(tree);
+
+	return ((bst_iter)Bound(tree, data, 0));
+}
+
+/*
+*	return value - iter to the first data that is larger than data, or
+*	BstEnd if there is none.
+*	arguments - tree management struct, void *data to compare with.
+*	one comparison per level.
+*/
+bst_iter BstUpperBound(bs_tree_t *tree, const void *data)
+{
+	assert(tree);
+
+	return ((bst_iter)Bound(tree, data, 1));
+}
+
+/*
+*	return value - success / fail, like BstForEach.
+*	arguments - tree management struct, range ends, action function, param
+*	this function performs the given action for each element from low to
+*	high (both included), in order. O(log n + k).
+*/
+int BstForEachInRange(bs_tree_t *tree, const void *low, const void *high,
+										action_func_t act_func, void *param)
+{
+	assert(tree);
+	assert(act_func);
+
+	if (tree->cmp_func(low, high, PARAM) > 0)
+	{
+		return 0;
+	}
+
+	return BstForEach(BstLowerBound(tree, low), BstUpperBound(tree, high),
+															act_func, param);
+}
+
+/*
+*	return value - number of elements from low to high (both included).
+*	arguments - tree management struct, range ends.
+*	two root to leaf walks over the subtree sizes, O(log n).
+*/
+size_t BstCountInRange(const bs_tree_t *tree, const void *low,
+															const void *high)
+{
+	assert(tree);
+
+	if (tree->cmp_func(low, high, PARAM) > 0)
+	{
+		return 0;
+	}
+
+	return (CountBelow(tree, high, 1) - CountBelow(tree, low, 0));
+}
+
+/*
+*	return value - returns numbe of elements
+*	arguments - tree management struct.
+*	this function returns the number of elements in the tree. O(1).
+*/
+size_t BstCount(const bs_tree_t *tree)
+{
+	assert(tree);
+
+	return tree->root.size;
+}
+
+/*
+*	return value - number of elements smaller than data.
+*	arguments - tree management struct, void *data to rank (need not be in
+*	the tree).
+*	one comparison per level, O(log n) in a balanced tree.
+*/
+size_t BstRank(const bs_tree_t *tree, const void *data)
+{
+	assert(tree);
+
+	return CountBelow(tree, data, 0);
+}
+
+/*
+*	return value - iter to the k-th smallest element (counting from 0), or
+*	BstEnd if the tree has k elements or less.
+*	arguments - tree management struct, k.
+*	O(log n) in a balanced tree, no comparisons.
+*/
+bst_iter BstSelect(bs_tree_t *tree, size_t k)
+{
+	tree_node_t *node = NULL;
+
+	assert(tree);
+
+	node = ROOT;
+	while (node && k != SIZE(node->child[0]))
+	{
+		if (k < SIZE(node->child[0]))
+		{
+			node = node->child[0];
+		}
+		else
+		{
+			k -= SIZE(node->child[0]) + 1;
+			node = node->child[1];
+		}
+	}
+
+	return (node ? (bst_iter)node : BstEnd(tree));
+}
+
+/*
+*	takes target out of the tree under sentinel, rebalancing it if asked to.
+*	target itself is left alone.
+*/
+static void Unlink(tree_node_t *sentinel, tree_node_t *target_node,
+															int is_balanced)
+{
+	tree_node_t *successor = NULL;
+	tree_node_t *moved_up = NULL, *moved_up_parent = NULL;
+	int removed_color = target_node->color;
+
+	if (!(target_node->child[0] && target_node->child[1]))
+	{
+		moved_up = target_node->child[HASRIGHTCHILD(target_node)];
+		moved_up_parent = PARENT(target_node);
+		Transplant(target_node, moved_up);
+	}
+	else
+	{
+		/*the successor (no left child) takes the target's place*/
+		successor = NEXT(target_node);
+		removed_color = successor->color;
+		moved_up = successor->child[1];
+
+		if (PARENT(successor) == target_node)
+		{
+			moved_up_parent = successor;
+		}
+		else
+		{
+			moved_up_parent = PARENT(successor);
+			Transplant(successor, moved_up);
+			successor->child[1] = target_node->child[1];
+			PARENT(successor->child[1]) = successor;
+		}
+
+		Transplant(target_node, successor);
+		successor->child[0] = target_node->child[0];
+		PARENT(successor->child[0]) = successor;
+		successor->color = target_node->color;
+		successor->size = target_node->size;
+	}
+
+	/*every subtree from the splice point up lost one node*/
+	UpdateSizes(moved_up_parent, (size_t)-1);
+
+	if (is_balanced && BLACK == removed_color)
+	{
+		RemoveFixup(sentinel, moved_up, moved_up_parent);
+	}
+}
+
+/*
+*	return value - element's data
 *	arguments - tree iterator.
-*	The function returns the data of given iterator.
+*	this function removes given element. O(log n) in a balanced tree.
 */
-void *BstGetData(bst_iter iter)
+void *BstRemove(bst_iter iter)
 {
+	bs_tree_t *tree = NULL;
+	tree_node_t *target_node = NULL;
+	void *data = NULL;
+
 	assert(iter);
-	return (((tree_node_t *)iter)->data);
+
+	target_node = (tree_node_t *)iter;
+	data = target_node->data;
+	tree = TreeOfNode(target_node);
+
+	Unlink(&tree->root, target_node, tree->is_balanced);
+	FreeNode(target_node);
+	
+	return data;
 }
 
-int BstIsSameIter(bst_iter iter1, bst_iter iter2)
+/*
+*	return value - success / fail.
+*	arguments - tree management struct, action function, param
+*	this function performs the given action for each element.
+*/
+int BstForEach(bst_iter from, bst_iter to, action_func_t act_func, void *param)
 {
-	assert(iter1);
-	assert(iter2);
-	return (iter1 == iter2);
-}
\ No newline at end of file
+	tree_node_t *from_node = NULL, *to_node = NULL;
+	int func_result = 0;
+
+	assert(from);
+	assert(to);
+	assert(act_func);
+
+	from_node = (tree_node_t *)from;
+	to_node = (tree_node_t *)to;
+
+	while (from_node != to_node && !func_result)
+	{
+		func_result = act_func(BstGetData((bst_iter)from_node), param);
+		from_node = (tree_node_t *)BstNext((bst_iter)from_node);
+	}
+
+	return (from_node != to_node);
+}
+
+/*
+*	return value - empty/not empty.
+*	arguments - tree management struct.
+*	The function checks if the tree is empty or not.
+*/
+int BstIsEmpty(const bs_tree_t *tree)
+{
+	assert(tree);
+	return (ROOT ? 0 : 1);
+}
+
+/*
+*	return value - iterator to the first data.
+*	arguments - tree management struct.
+*	The function returns the beginning of the tree.
+*/
+bst_iter BstBegin(bs_tree_t *tree)
+{
+	tree_node_t *node = NULL;
+
+	assert(tree);
+
+	node = &tree->root;
+	while (node->child[0])
+	{
+		node = node->child[0];
+	}
+
+	return ((bst_iter)node);
+}
+
+/*
+*	return value - iterator to the last data.
+*	arguments - tree management struct.
+*	The function returns the last data.
+*/
+bst_iter BstEnd(bs_tree_t *tree)
+{
+	assert(tree);
+	return ((bst_iter)&(tree->root));
+}
+
+/*
+*	return value - next iterator.
+*	arguments - tree iteraor.
+*	The function returns the next iterator.
+*/
+bst_iter BstNext(bst_iter iter)
+{
+	tree_node_t *node = NULL;
+
+	assert(iter);
+
+	node = (tree_node_t *)iter;
+	if (HASRIGHTCHILD(node))
+	{
+		node = node->child[1];
+		while (HASLEFTCHILD(node))
+		{
+			node = node->child[0];
+		}
+
+		return ((bst_iter)(node));
+	}
+	else
+	{
+		while (ISBIGGERCHILD(node))
+		{
+			node = PARENT(node);
+		}
+		
+		return ((bst_iter)PARENT(node));
+	}
+}
+
+/*
+*	return value - previous iterator.
+*	arguments - tree iteraor.
+*	The function returns the previous iterator.
+*/
+bst_iter BstPrev(bst_iter iter)
+{
+	tree_node_t *node = NULL;
+
+	assert(iter);
+
+	node = (tree_node_t *)iter;
+	if (HASLEFTCHILD(node))
+	{
+		node = node->child[0];
+		while (HASRIGHTCHILD(node))
+		{
+			node = node->child[1];
+		}
+
+		return ((bst_iter)(node));
+	}
+	else
+	{
+		while (ISSMALLERCHILD(node))
+		{
+			node = PARENT(node);
+		}
+
+		return ((bst_iter)PARENT(node));
+	}
+}
+
+/*
+*	return value - iterator data.
+*	arguments - tree iterator.
+*	The function returns the data of given iterator.
+*/
+void *BstGetData(bst_iter iter)
+{
+	assert(iter);
+	return (((tree_node_t *)iter)->data);
+}
+
+int BstIsSameIter(bst_iter iter1, bst_iter iter2)
+{
+	assert(iter1);
+	assert(iter2);
+	return (iter1 == iter2);
+}
+
+/***************************** split, join, sets ****************************/
+
+static void PieceInit(piece_t *piece)
+{
+	piece->root.parent = NULL;
+	piece->root.data = NULL;
+	piece->root.child[0] = NULL;
+	piece->root.child[1] = NULL;
+	piece->root.color = BLACK;
+	piece->root.size = 0;
+	piece->black_height = 0;
+}
+
+/*puts subtree under piece, turning its root black if it is red*/
+static void PieceTake(piece_t *piece, tree_node_t *subtree,
+														size_t black_height)
+{
+	PieceInit(piece);
+	piece->root.child[0] = subtree;
+	piece->black_height = black_height;
+
+	if (subtree)
+	{
+		PARENT(subtree) = &piece->root;
+		piece->root.size = subtree->size;
+		if (ISRED(subtree))
+		{
+			subtree->color = BLACK;
+			++piece->black_height;
+		}
+	}
+}
+
+static void PieceMove(piece_t *to, piece_t *from)
+{
+	PieceTake(to, from->root.child[0], from->black_height);
+	PieceInit(from);
+}
+
+static size_t BlackHeight(const tree_node_t *node)
+{
+	size_t height = 0;
+
+	for (; node; node = node->child[0])
+	{
+		height += ISBLACK(node);
+	}
+
+	return height;
+}
+
+static void TreeToPiece(bs_tree_t *tree, piece_t *piece)
+{
+	PieceTake(piece, ROOT, BlackHeight(ROOT));
+	ROOT = NULL;
+	tree->root.size = 0;
+}
+
+static void PieceToTree(piece_t *piece, bs_tree_t *tree)
+{
+	ROOT = piece->root.child[0];
+	tree->root.size = piece->root.size;
+	if (ROOT)
+	{
+		PARENT(ROOT) = &tree->root;
+	}
+
+	PieceInit(piece);
+}
+
+/*
+*	left becomes left, middle and right, in that order. right is emptied.
+*	O(1 + the difference in black heights).
+*/
+static void JoinPieces(piece_t *left, tree_node_t *middle, piece_t *right)
+{
+	piece_t *taller = NULL, *shorter = NULL;
+	tree_node_t *parent = NULL, *node = NULL, *short_root = NULL;
+	size_t height = 0;
+	int side = 0;
+
+	if (left->black_height == right->black_height)
+	{
+		middle->child[0] = left->root.child[0];
+		middle->child[1] = right->root.child[0];
+		middle->color = BLACK;
+		middle->size = left->root.size + right->root.size + 1;
+		if (middle->child[0])
+		{
+			PARENT(middle->child[0]) = middle;
+		}
+		if (middle->child[1])
+		{
+			PARENT(middle->child[1]) = middle;
+		}
+
+		PieceTake(left, middle, left->black_height + 1);
+		PieceInit(right);
+
+		return;
+	}
+
+	/*side 1: down the right spine of a taller left, 0: the opposite*/
+	side = (left->black_height > right->black_height);
+	taller = side ? left : right;
+	shorter = side ? right : left;
+	short_root = shorter->root.child[0];
+
+	parent = &taller->root;
+	node = parent->child[0];
+	height = taller->black_height;
+	while (ISRED(node) || height > shorter->black_height)
+	{
+		height -= ISBLACK(node);
+		parent = node;
+		node = node->child[side];
+	}
+
+	/*a red middle over two subtrees of equal black height*/
+	middle->child[!side] = node;
+	middle->child[side] = short_root;
+	middle->color = RED;
+	middle->size = SIZE(node) + SIZE(short_root) + 1;
+	if (node)
+	{
+		PARENT(node) = middle;
+	}
+	if (short_root)
+	{
+		PARENT(short_root) = middle;
+	}
+
+	parent->child[(parent == &taller->root) ? 0 : side] = middle;
+	PARENT(middle) = parent;
+	UpdateSizes(parent, SIZE(short_root) + 1);
+	taller->black_height += InsertFixup(&taller->root, middle);
+
+	PieceInit(shorter);
+	if (!side)
+	{
+		PieceMove(left, right);
+	}
+}
+
+/*left becomes left and right, in that order. right is emptied*/
+static void JoinTwoPieces(piece_t *left, piece_t *right)
+{
+	tree_node_t *smallest = right->root.child[0];
+
+	if (!smallest)
+	{
+		return;
+	}
+
+	while (smallest->child[0])
+	{
+		smallest = smallest->child[0];
+	}
+
+	Unlink(&right->root, smallest, 1);
+	right->black_height = BlackHeight(right->root.child[0]);
+	JoinPieces(left, smallest, right);
+}
+
+/*
+*	moves the nodes of piece smaller than data to left, the rest to right.
+*	if equal is given, the first node equal to data on the way down goes to
+*	*equal instead (NULL if there is none). O(log n).
+*/
+static void SplitPiece(const bs_tree_t *tree, piece_t *piece,
+							const void *data, piece_t *left, piece_t *right,
+													tree_node_t **equal)
+{
+	tree_node_t *node = NULL, *last = NULL, *parent = NULL;
+	piece_t part;
+	size_t height = piece->black_height;
+	int side = 0, parent_side = 0, result = 0;
+
+	PieceInit(left);
+	PieceInit(right);
+	if (equal)
+	{
+		*equal = NULL;
+	}
+
+	last = &piece->root;
+	node = ROOT_OF(piece);
+	while (node)
+	{
+		result = tree->cmp_func(data, node->data, PARAM);
+		if (equal && 0 == result)
+		{
+			*equal = node;
+			PieceTake(left, node->child[0], height - ISBLACK(node));
+			PieceTake(right, node->child[1], height - ISBLACK(node));
+			node->child[0] = NULL;
+			node->child[1] = NULL;
+			node->size = 1;
+			break;
+		}
+
+		height -= ISBLACK(node);
+		last = node;
+		side = (result > 0);
+		node = node->child[side];
+	}
+
+	/*
+	*	climbing back, every node joins the side it belongs to together with
+	*	its subtree that the search did not enter. height is the black
+	*	height of the node's children.
+	*/
+	while (last != &piece->root)
+	{
+		parent = PARENT(last);
+		parent_side = ISBIGGERCHILD(last);
+
+		PieceTake(&part, last->child[!side], height);
+		height += ISBLACK(last);
+
+		if (0 == side)
+		{
+			JoinPieces(right, last, &part);
+		}
+		else
+		{
+			JoinPieces(&part, last, left);
+			PieceMove(left, &part);
+		}
+
+		side = parent_side;
+		last = parent;
+	}
+
+	PieceInit(piece);
+}
+
+/*
+*	return value - a new tree with every element of tree that is not smaller
+*	than data, NULL on failure (tree is then unchanged).
+*	arguments - balanced tree, void *data to split at.
+*	The function keeps the smaller elements in tree and moves the rest,
+*	nodes and all. both trees stay balanced. O(log n).
+*/
+bs_tree_t *BstSplit(bs_tree_t *tree, const void *data)
+{
+	bs_tree_t *rest = NULL;
+	piece_t whole, left, right;
+
+	assert(tree);
+	assert(tree->is_balanced);
+
+	rest = BstCreateBalanced(tree->cmp_func, PARAM);
+	if (!rest)
+	{
+		return NULL;
+	}
+
+	if (SUCCESS != ShareBlocks(rest, tree))
+	{
+		BstDestroy(rest);
+
+		return NULL;
+	}
+
+	TreeToPiece(tree, &whole);
+	SplitPiece(tree, &whole, data, &left, &right, NULL);
+	PieceToTree(&left, tree);
+	PieceToTree(&right, rest);
+
+	return rest;
+}
+
+/*
+*	return value - SUCCESS, or MALLOC_FAIL (both trees are then unchanged).
+*	arguments - balanced trees, every element of left smaller than (or equal
+*	to) every element of right.
+*	The function moves all of right's nodes to the end of left, leaving
+*	right empty. O(log n).
+*/
+int BstJoin(bs_tree_t *left, bs_tree_t *right)
+{
+	piece_t left_piece, right_piece;
+
+	assert(left);
+	assert(right);
+	assert(left->is_balanced && right->is_balanced);
+
+	if (SUCCESS != ShareBlocks(left, right))
+	{
+		return MALLOC_FAIL;
+	}
+
+	TreeToPiece(left, &left_piece);
+	TreeToPiece(right, &right_piece);
+	JoinTwoPieces(&left_piece, &right_piece);
+	PieceToTree(&left_piece, left);
+
+	return SUCCESS;
+}
+
+/*the result of a set operation when tree1 or tree2 is empty*/
+static void SetBaseCase(set_frame_t *frame, int operation,
+									action_func_t release_func, void *param)
+{
+	PieceInit(&frame->result);
+
+	if (ROOT_OF(&frame->tree1) && UNION != operation &&
+											DIFFERENCE != operation)
+	{
+		FreeNodes(&frame->tree1.root, release_func, param);
+	}
+	else if (ROOT_OF(&frame->tree1))
+	{
+		PieceMove(&frame->result, &frame->tree1);
+	}
+
+	if (ROOT_OF(&frame->tree2) && UNION != operation)
+	{
+		FreeNodes(&frame->tree2.root, release_func, param);
+	}
+	else if (ROOT_OF(&frame->tree2))
+	{
+		PieceMove(&frame->result, &frame->tree2);
+	}
+
+	PieceInit(&frame->tree1);
+	PieceInit(&frame->tree2);
+}
+
+/*joins the two halves of a set operation around its middle*/
+static void SetCombine(set_frame_t *frame, piece_t *right, int operation,
+									action_func_t release_func, void *param)
+{
+	if (UNION == operation || (INTERSECTION == operation && frame->found))
+	{
+		/*of two equal elements, dest's one stays*/
+		if (frame->found)
+		{
+			DropNode(frame->middle, release_func, param);
+			frame->middle = frame->found;
+		}
+
+		JoinPieces(&frame->left_result, frame->middle, right);
+	}
+	else
+	{
+		DropNode(frame->middle, release_func, param);
+		if (frame->found)
+		{
+			DropNode(frame->found, release_func, param);
+		}
+
+		JoinTwoPieces(&frame->left_result, right);
+	}
+
+	PieceMove(&frame->result, &frame->left_result);
+}
+
+/*
+*	dest = dest op src, by splitting dest around the root of src and
+*	recursing on both halves, with an explicit stack one frame per level of
+*	src. O(m log(n / m + 1)) for trees of m <= n elements.
+*/
+static int SetOperation(bs_tree_t *dest, bs_tree_t *src, int operation,
+									action_func_t release_func, void *param)
+{
+	set_frame_t *frames = NULL, *frame = NULL, *child = NULL;
+	tree_node_t *middle = NULL;
+	size_t depth = 0;
+
+	assert(dest);
+	assert(src);
+	assert(dest->is_balanced && src->is_balanced);
+
+	/*a red-black tree is at most twice as deep as its black height*/
+	frames = malloc((2 * MAX_DEPTH + 2) * sizeof(set_frame_t));
+	if (!frames || SUCCESS != ShareBlocks(dest, src))
+	{
+		free(frames);
+
+		return MALLOC_FAIL;
+	}
+
+	TreeToPiece(dest, &frames[0].tree1);
+	TreeToPiece(src, &frames[0].tree2);
+	frames[0].stage = 0;
+
+	for (;;)
+	{
+		frame = &frames[depth];
+		child = frame + 1;
+
+		if (0 == frame->stage &&
+				(!ROOT_OF(&frame->tree1) || !ROOT_OF(&frame->tree2)))
+		{
+			SetBaseCase(frame, operation, release_func, param);
+			frame->stage = 2;
+			child = NULL;
+		}
+		else if (0 == frame->stage)
+		{
+			/*split tree1 around the root of tree2, left halves go first*/
+			middle = ROOT_OF(&frame->tree2);
+			frame->middle = middle;
+			PieceTake(&child->tree2, middle->child[0],
+										frame->tree2.black_height - 1);
+			PieceTake(&frame->right2, middle->child[1],
+										frame->tree2.black_height - 1);
+			PieceInit(&frame->tree2);
+			SplitPiece(dest, &frame->tree1, middle->data, &child->tree1,
+									&frame->right1, &frame->found);
+
+			child->stage = 0;
+			frame->stage = 1;
+			++depth;
+			continue;
+		}
+		else if (1 == frame->stage)
+		{
+			PieceMove(&frame->left_result, &child->result);
+			PieceMove(&child->tree1, &frame->right1);
+			PieceMove(&child->tree2, &frame->right2);
+
+			child->stage = 0;
+			frame->stage = 2;
+			++depth;
+			continue;
+		}
+		else
+		{
+			SetCombine(frame, &child->result, operation, release_func, param);
+		}
+
+		if (0 == depth)
+		{
+			break;
+		}
+		--depth;
+	}
+
+	PieceToTree(&frames[0].result, dest);
+	free(frames);
+
+	return SUCCESS;
+}
+
+/*
+*	return value - SUCCESS, or MALLOC_FAIL (both trees are then unchanged).
+*	arguments - balanced trees with the same order, release function (may be
+*	NULL), param for release function.
+*	The function moves every element of src into dest, reusing its nodes.
+*	an element equal to one dest already has is dropped, and its data is
+*	handed to release_func. src is left empty.
+*	O(m log(n / m + 1)) for trees of m <= n elements.
+*/
+int BstUnion(bs_tree_t *dest, bs_tree_t *src, action_func_t release_func,
+																void *param)
+{
+	return SetOperation(dest, src, UNION, release_func, param);
+}
+
+/*
+*	return value - SUCCESS, or MALLOC_FAIL (both trees are then unchanged).
+*	arguments - balanced trees with the same order, release function (may be
+*	NULL), param for release function.
+*	The function leaves in dest only the elements that src has an equal
+*	of. src is left empty. every data dropped from either tree is handed
+*	to release_func. O(m log(n / m + 1)).
+*/
+int BstIntersection(bs_tree_t *dest, bs_tree_t *src,
+									action_func_t release_func, void *param)
+{
+	return SetOperation(dest, src, INTERSECTION, release_func, param);
+}
+
+/*
+*	return value - SUCCESS, or MALLOC_FAIL (both trees are then unchanged).
+*	arguments - balanced trees with the same order, release function (may be
+*	NULL), param for release function.
+*	The function removes from dest every element that src has an equal of.
+*	src is left empty. every data dropped from either tree is handed to
+*	release_func. O(m log(n / m + 1)).
+*/
+int BstDifference(bs_tree_t *dest, bs_tree_t *src,
+									action_func_t release_func, void *param)
+{
+	return SetOperation(dest, src, DIFFERENCE, release_func, param);
+}
+
+/******************************* frozen snapshot ****************************/
+
+#ifndef __GNUC__
+static size_t TrailingOnes(size_t index)
+{
+	size_t counter = 0;
+
+	for (; index & 1; index >>= 1)
+	{
+		++counter;
+	}
+
+	return counter;
+}
+#endif
+
+/*Eytzinger positions in order: the smallest one below k, and the next one*/
+static size_t FrozenLeftmost(size_t k, size_t num_of_elements)
+{
+	while (2 * k <= num_of_elements)
+	{
+		k *= 2;
+	}
+
+	return k;
+}
+
+static size_t FrozenRightmost(size_t k, size_t num_of_elements)
+{
+	while (2 * k + 1 <= num_of_elements)
+	{
+		k = 2 * k + 1;
+	}
+
+	return k;
+}
+
+/*
+*	return value - read-only snapshot of the tree, NULL on failure.
+*	arguments - tree management struct.
+*	The function copies the datas (not what they point to) into an
+*	Eytzinger array. the snapshot does not follow later changes to the
+*	tree, which may go on being written. O(n).
+*/
+bst_frozen_t *BstFreeze(const bs_tree_t *tree)
+{
+	bst_frozen_t *frozen = NULL;
+	tree_node_t *node = NULL;
+	size_t num_of_elements = 0, k = 0;
+	char *buffer = NULL;
+
+	assert(tree);
+
+	num_of_elements = BstCount(tree);
+	frozen = malloc(sizeof(bst_frozen_t) + CACHE_LINE +
+								(num_of_elements + 1) * sizeof(void *));
+	if (!frozen)
+	{
+		return NULL;
+	}
+
+	/*a cache line aligned array keeps every group of siblings on one line*/
+	buffer = (char *)frozen + sizeof(bst_frozen_t);
+	buffer += (CACHE_LINE - (size_t)buffer % CACHE_LINE) % CACHE_LINE;
+	frozen->data = (void **)buffer;
+	frozen->data[0] = NULL;
+	frozen->num_of_elements = num_of_elements;
+	frozen->cmp_func = tree->cmp_func;
+	frozen->param = tree->param;
+
+	node = (tree_node_t *)BstBegin((bs_tree_t *)tree);
+	k = FrozenLeftmost(1, num_of_elements);
+	while (node != &tree->root)
+	{
+		frozen->data[k] = node->data;
+		node = NEXT(node);
+		k = BstFrozenNext(frozen, k);
+	}
+
+	return frozen;
+}
+
+void BstFrozenDestroy(bst_frozen_t *frozen)
+{
+	assert(frozen);
+
+	free(frozen);
+}
+
+size_t BstFrozenCount(const bst_frozen_t *frozen)
+{
+	assert(frozen);
+
+	return frozen->num_of_elements;
+}
+
+/*
+*	return value - iter to the first data that is not smaller than data, or
+*	BstFrozenEnd if there is none.
+*	arguments - snapshot, void *data to compare with.
+*	one comparison per level and no branch on its result. the line holding
+*	the descendants a few levels down is prefetched on the way.
+*/
+bst_frozen_iter BstFrozenLowerBound(const bst_frozen_t *frozen,
+															const void *data)
+{
+	size_t k = 1;
+
+	assert(frozen);
+
+	while (k <= frozen->num_of_elements)
+	{
+		PREFETCH(frozen->data + k * LINE_OF_DESCENDANTS);
+		k = 2 * k + (frozen->cmp_func(data, frozen->data[k],
+												frozen->param) > 0);
+	}
+
+	/*undo the right turns taken after the last left one*/
+	return (k >> (TRAILING_ONES(k) + 1));
+}
+
+/*
+*	return value - iter to the wanted data (the first equal one), or
+*	BstFrozenEnd.
+*	arguments - snapshot, void *data to find.
+*/
+bst_frozen_iter BstFrozenFind(const bst_frozen_t *frozen, const void *data)
+{
+	size_t k = BstFrozenLowerBound(frozen, data);
+
+	return ((0 == k ||
+			frozen->cmp_func(data, frozen->data[k], frozen->param)) ?
+		BstFrozenEnd(frozen) : k);
+}
+
+bst_frozen_iter BstFrozenBegin(const bst_frozen_t *frozen)
+{
+	assert(frozen);
+
+	return ((0 == frozen->num_of_elements) ? BstFrozenEnd(frozen) :
+								FrozenLeftmost(1, frozen->num_of_elements));
+}
+
+bst_frozen_iter BstFrozenEnd(const bst_frozen_t *frozen)
+{
+	assert(frozen);
+	(void)frozen;
+
+	return 0;
+}
+
+/*
+*	return value - next iterator, BstFrozenEnd after the last one.
+*	arguments - snapshot, iterator.
+*/
+bst_frozen_iter BstFrozenNext(const bst_frozen_t *frozen, bst_frozen_iter iter)
+{
+	assert(frozen);
+	assert(iter);
+
+	if (2 * iter + 1 <= frozen->num_of_elements)
+	{
+		return FrozenLeftmost(2 * iter + 1, frozen->num_of_elements);
+	}
+
+	/*climb while coming from a right child, then once more*/
+	return (iter >> (TRAILING_ONES(iter) + 1));
+}
+
+/*
+*	return value - previous iterator. BstFrozenPrev(BstFrozenEnd) is the
+*	last data.
+*	arguments - snapshot, iterator.
+*/
+bst_frozen_iter BstFrozenPrev(const bst_frozen_t *frozen, bst_frozen_iter iter)
+{
+	assert(frozen);
+
+	if (0 == iter)
+	{
+		return ((0 == frozen->num_of_elements) ? BstFrozenEnd(frozen) :
+								FrozenRightmost(1, frozen->num_of_elements));
+	}
+
+	if (2 * iter <= frozen->num_of_elements)
+	{
+		return FrozenRightmost(2 * iter, frozen->num_of_elements);
+	}
+
+	/*climb while coming from a left child, then once more*/
+	while (iter > 1 && 0 == iter % 2)
+	{
+		iter /= 2;
+	}
+
+	return (iter / 2);
+}
+
+void *BstFrozenGetData(const bst_frozen_t *frozen, bst_frozen_iter iter)
+{
+	assert(frozen);
+	assert(0 < iter && iter <= frozen->num_of_elements);
+
+	return frozen->data[iter];
+}
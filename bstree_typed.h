@@ -0,0 +1,467 @@
+/*
+*	Typed bstree: a red-black tree whose key lives inside the node and is
+*	compared with an inlined expression instead of cmp_func, so a lookup
+*	reads one node per level and makes no indirect calls. It keeps the
+*	bstree interface, with a pointer to the node as the iterator and NULL as
+*	the end.
+*
+*	Define the following and include this file, once per key type:
+*		TBST_NAME - prefix of the generated types and functions
+*		TBST_KEY - key type, copied by value (an integer, or a struct
+*		holding a fixed size byte string)
+*		TBST_LESS(a, b) - optional, nonzero if key a is smaller than key b.
+*		defaults to ((a) < (b)).
+*
+*	e.g.
+*		#define TBST_NAME U64Bst
+*		#define TBST_KEY unsigned long
+*		#include "bstree_typed.h"
+*	generates U64Bst_t, U64Bst_node_t, U64BstCreate, U64BstInsert, ...
+*	The parameters are undefined at the end of this file.
+*/
+
+/*WITHOUT USING RECURSION*/
+
+#ifndef BSTREE_TYPED_H
+#define BSTREE_TYPED_H
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define TBST_CAT2(a, b) a##b
+#define TBST_CAT(a, b) TBST_CAT2(a, b)
+#define TBST_FN(name) TBST_CAT(TBST_NAME, name)
+
+#ifdef __GNUC__
+#define TBST_FUNC static __inline__ __attribute__((unused))
+#else
+#define TBST_FUNC static
+#endif
+
+#define TBST_RED 0
+#define TBST_BLACK 1
+#define TBST_ISRED(node) ((node) && TBST_RED == (node)->color)
+#define TBST_ISBIGGERCHILD(node) ((node)->parent->child[1] == (node))
+
+#endif /*BSTREE_TYPED_H*/
+
+#ifndef TBST_NAME
+#error "define TBST_NAME before including bstree_typed.h"
+#endif
+
+#ifndef TBST_KEY
+#error "define TBST_KEY before including bstree_typed.h"
+#endif
+
+#ifndef TBST_LESS
+#define TBST_LESS(a, b) ((a) < (b))
+#endif
+
+#define TBST_TREE TBST_FN(_t)
+#define TBST_NODE TBST_FN(_node_t)
+#define TBST_ROOT(tree) (tree)->root.child[0]
+
+typedef struct TBST_NODE TBST_NODE;
+typedef struct TBST_TREE TBST_TREE;
+
+struct TBST_NODE
+{
+	TBST_NODE *parent;
+	TBST_NODE *child[2]; /*0 = left(smaller), 1 = right (larger)*/
+	TBST_KEY key;
+	void *data;
+	int color;
+};
+
+struct TBST_TREE
+{
+	TBST_NODE root; /*sentinel, its left child is the real root*/
+	size_t num_of_elements;
+};
+
+/*
+*	This function creates an empty typed tree.
+*	Return value - tree handle, NULL on failure.
+*/
+TBST_FUNC TBST_TREE *TBST_FN(Create)(void)
+{
+	TBST_TREE *tree = malloc(sizeof(TBST_TREE));
+
+	if (tree)
+	{
+		tree->root.parent = NULL;
+		tree->root.child[0] = NULL;
+		tree->root.child[1] = NULL;
+		tree->root.data = NULL;
+		tree->root.color = TBST_BLACK;
+		tree->num_of_elements = 0;
+	}
+
+	return tree;
+}
+
+/*
+*	This function frees the tree and its nodes (not the datas).
+*	Arguments - tree handle.
+*/
+TBST_FUNC void TBST_FN(Destroy)(TBST_TREE *tree)
+{
+	TBST_NODE *node = NULL, *parent = NULL;
+
+	assert(tree);
+
+	node = TBST_ROOT(tree);
+	while (node)
+	{
+		if (node->child[0])
+		{
+			node = node->child[0];
+		}
+		else if (node->child[1])
+		{
+			node = node->child[1];
+		}
+		else
+		{
+			parent = node->parent;
+			parent->child[TBST_ISBIGGERCHILD(node)] = NULL;
+			free(node);
+			node = (parent == &tree->root) ? NULL : parent;
+		}
+	}
+
+	free(tree);
+}
+
+TBST_FUNC size_t TBST_FN(Count)(const TBST_TREE *tree)
+{
+	assert(tree);
+
+	return tree->num_of_elements;
+}
+
+TBST_FUNC int TBST_FN(IsEmpty)(const TBST_TREE *tree)
+{
+	assert(tree);
+
+	return (NULL == TBST_ROOT(tree));
+}
+
+/*brings node->child[!side] up into node's place*/
+TBST_FUNC void TBST_FN(Rotate_)(TBST_NODE *node, int side)
+{
+	TBST_NODE *pivot = node->child[!side];
+
+	node->child[!side] = pivot->child[side];
+	if (pivot->child[side])
+	{
+		pivot->child[side]->parent = node;
+	}
+
+	pivot->parent = node->parent;
+	node->parent->child[TBST_ISBIGGERCHILD(node)] = pivot;
+	pivot->child[side] = node;
+	node->parent = pivot;
+}
+
+/*
+*	return value - iter to the new node, NULL on failure.
+*	arguments - tree handle, key, data kept beside it.
+*	equal keys are kept, the newest one first. O(log n).
+*/
+TBST_FUNC TBST_NODE *TBST_FN(Insert)(TBST_TREE *tree, TBST_KEY key,
+																void *data)
+{
+	TBST_NODE *node = NULL, *parent = NULL, *grandparent = NULL;
+	TBST_NODE *uncle = NULL, *new_node = NULL;
+	int side = 0;
+
+	assert(tree);
+
+	new_node = malloc(sizeof(TBST_NODE));
+	if (!new_node)
+	{
+		return NULL;
+	}
+
+	new_node->child[0] = NULL;
+	new_node->child[1] = NULL;
+	new_node->key = key;
+	new_node->data = data;
+	new_node->color = TBST_RED;
+
+	parent = &tree->root;
+	side = 0;
+	while (parent->child[side])
+	{
+		parent = parent->child[side];
+		side = (0 != TBST_LESS(parent->key, key));
+	}
+
+	parent->child[side] = new_node;
+	new_node->parent = parent;
+	++tree->num_of_elements;
+
+	node = new_node;
+	while (TBST_ISRED(node->parent))
+	{
+		parent = node->parent;
+		grandparent = parent->parent;
+		side = TBST_ISBIGGERCHILD(parent);
+		uncle = grandparent->child[!side];
+
+		if (TBST_ISRED(uncle))
+		{
+			parent->color = TBST_BLACK;
+			uncle->color = TBST_BLACK;
+			grandparent->color = TBST_RED;
+			node = grandparent;
+		}
+		else
+		{
+			if (node == parent->child[!side])
+			{
+				node = parent;
+				TBST_FN(Rotate_)(node, side);
+				parent = node->parent;
+			}
+
+			parent->color = TBST_BLACK;
+			grandparent->color = TBST_RED;
+			TBST_FN(Rotate_)(grandparent, !side);
+		}
+	}
+
+	TBST_ROOT(tree)->color = TBST_BLACK;
+
+	return new_node;
+}
+
+/*
+*	return value - iter to the first node whose key is not smaller than key,
+*	NULL if there is none.
+*	arguments - tree handle, key. one inlined comparison per level.
+*/
+TBST_FUNC TBST_NODE *TBST_FN(LowerBound)(const TBST_TREE *tree, TBST_KEY key)
+{
+	TBST_NODE *node = NULL, *bound = NULL;
+
+	assert(tree);
+
+	node = TBST_ROOT(tree);
+	while (node)
+	{
+		if (TBST_LESS(node->key, key))
+		{
+			node = node->child[1];
+		}
+		else
+		{
+			bound = node;
+			node = node->child[0];
+		}
+	}
+
+	return bound;
+}
+
+/*
+*	return value - iter to the first node with an equal key, NULL if none.
+*	arguments - tree handle, key.
+*/
+TBST_FUNC TBST_NODE *TBST_FN(Find)(const TBST_TREE *tree, TBST_KEY key)
+{
+	TBST_NODE *node = TBST_FN(LowerBound)(tree, key);
+
+	return ((node && !TBST_LESS(key, node->key)) ? node : NULL);
+}
+
+TBST_FUNC TBST_NODE *TBST_FN(Begin)(const TBST_TREE *tree)
+{
+	TBST_NODE *node = NULL;
+
+	assert(tree);
+
+	node = TBST_ROOT(tree);
+	while (node && node->child[0])
+	{
+		node = node->child[0];
+	}
+
+	return node;
+}
+
+/*
+*	return value - next iter, NULL after the last one.
+*	arguments - tree iter.
+*/
+TBST_FUNC TBST_NODE *TBST_FN(Next)(TBST_NODE *node)
+{
+	assert(node);
+
+	if (node->child[1])
+	{
+		node = node->child[1];
+		while (node->child[0])
+		{
+			node = node->child[0];
+		}
+
+		return node;
+	}
+
+	while (TBST_ISBIGGERCHILD(node))
+	{
+		node = node->parent;
+	}
+	node = node->parent;
+
+	/*only the sentinel has no parent*/
+	return (node->parent ? node : NULL);
+}
+
+/*
+*	return value - previous iter, NULL before the first one.
+*	arguments - tree iter.
+*/
+TBST_FUNC TBST_NODE *TBST_FN(Prev)(TBST_NODE *node)
+{
+	assert(node);
+
+	if (node->child[0])
+	{
+		node = node->child[0];
+		while (node->child[1])
+		{
+			node = node->child[1];
+		}
+
+		return node;
+	}
+
+	while (node->parent && !TBST_ISBIGGERCHILD(node))
+	{
+		node = node->parent;
+	}
+
+	return (node->parent && node->parent->parent ? node->parent : NULL);
+}
+
+/*puts new_node (possibly NULL) in old_node's place under its parent*/
+TBST_FUNC void TBST_FN(Transplant_)(TBST_NODE *old_node, TBST_NODE *new_node)
+{
+	old_node->parent->child[TBST_ISBIGGERCHILD(old_node)] = new_node;
+	if (new_node)
+	{
+		new_node->parent = old_node->parent;
+	}
+}
+
+/*
+*	return value - the removed node's data.
+*	arguments - tree handle, tree iter.
+*	O(log n).
+*/
+TBST_FUNC void *TBST_FN(Remove)(TBST_TREE *tree, TBST_NODE *target)
+{
+	TBST_NODE *successor = NULL, *node = NULL, *parent = NULL;
+	TBST_NODE *sibling = NULL;
+	void *data = NULL;
+	int removed_color = 0, side = 0;
+
+	assert(tree);
+	assert(target);
+
+	data = target->data;
+	removed_color = target->color;
+
+	if (!(target->child[0] && target->child[1]))
+	{
+		node = target->child[NULL != target->child[1]];
+		parent = target->parent;
+		TBST_FN(Transplant_)(target, node);
+	}
+	else
+	{
+		successor = TBST_FN(Next)(target);
+		removed_color = successor->color;
+		node = successor->child[1];
+
+		if (successor->parent == target)
+		{
+			parent = successor;
+		}
+		else
+		{
+			parent = successor->parent;
+			TBST_FN(Transplant_)(successor, node);
+			successor->child[1] = target->child[1];
+			successor->child[1]->parent = successor;
+		}
+
+		TBST_FN(Transplant_)(target, successor);
+		successor->child[0] = target->child[0];
+		successor->child[0]->parent = successor;
+		successor->color = target->color;
+	}
+
+	free(target);
+	--tree->num_of_elements;
+
+	if (TBST_RED == removed_color)
+	{
+		return data;
+	}
+
+	/*node (possibly NULL) is one black short*/
+	while (node != TBST_ROOT(tree) && !TBST_ISRED(node))
+	{
+		side = (parent->child[1] == node);
+		sibling = parent->child[!side];
+
+		if (TBST_ISRED(sibling))
+		{
+			sibling->color = TBST_BLACK;
+			parent->color = TBST_RED;
+			TBST_FN(Rotate_)(parent, side);
+			sibling = parent->child[!side];
+		}
+
+		if (!TBST_ISRED(sibling->child[0]) && !TBST_ISRED(sibling->child[1]))
+		{
+			sibling->color = TBST_RED;
+			node = parent;
+			parent = node->parent;
+		}
+		else
+		{
+			if (!TBST_ISRED(sibling->child[!side]))
+			{
+				sibling->child[side]->color = TBST_BLACK;
+				sibling->color = TBST_RED;
+				TBST_FN(Rotate_)(sibling, !side);
+				sibling = parent->child[!side];
+			}
+
+			sibling->color = parent->color;
+			parent->color = TBST_BLACK;
+			sibling->child[!side]->color = TBST_BLACK;
+			TBST_FN(Rotate_)(parent, side);
+			node = TBST_ROOT(tree);
+		}
+	}
+
+	if (node)
+	{
+		node->color = TBST_BLACK;
+	}
+
+	return data;
+}
+
+#undef TBST_ROOT
+#undef TBST_NODE
+#undef TBST_TREE
+#undef TBST_LESS
+#undef TBST_KEY
+#undef TBST_NAME
@@ -4,7 +4,11 @@
 
 #define LSB(data) ((data) & 1)
 #define ISLEAF(node) (NULL == (node)->child[0])? 1 : 0
-
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define ADDRESS_MASK(trie) ((unsigned int)(trie)->max_addresses)
+#define NO_VACANT_BLOCK (-1)
+#define MAX_BITS (sizeof(unsigned int) * 8)
+#define PAIRS_PER_SLAB 512
 
 enum return_status
 {
@@ -20,63 +24,121 @@ enum node_status
 	PARTIAL_OCCUPANCY_BELOW_NODE
 };
 
-static size_t PowerOfTwo(size_t bit_size_limit)
+/*
+* the children of a node are allocated as a pair, from slabs the trie owns.
+* free pairs are kept in a list linked through their first child[0], and
+* the slabs are only freed with the trie.
+*/
+struct btrie_slab_t
 {
-	size_t res = 1;
+	struct btrie_slab_t *next;
+	btrie_node_t nodes[2 * PAIRS_PER_SLAB];
+};
 
-	while (bit_size_limit > 0)
+/*a node of BTrieSetRange's walk and how far it got*/
+typedef struct range_frame_t
+{
+	btrie_node_t *node;
+	size_t node_low;
+	size_t level_counter;
+	int stage;
+} range_frame_t;
+
+/*
+* makes node a whole FULL or VACANT subtree of 2^level_counter addresses,
+* with its summaries to match.
+*/
+static void SetWholeNode(btrie_node_t *node, int status, size_t level_counter)
+{
+	node->status = status;
+	if (VACANT_BELOW_NODE == status)
 	{
-		res *= 2;
-		--bit_size_limit;
+		node->largest_vacant_block = (int)level_counter;
+		node->vacant_count = (size_t)1 << level_counter;
+	}
+	else
+	{
+		node->largest_vacant_block = NO_VACANT_BLOCK;
+		node->vacant_count = 0;
 	}
-
-	return res;
 }
 
-static void InitNode(btrie_node_t *node, int status)
+static void InitNode(btrie_node_t *node, int status, size_t level_counter)
 {
 	assert(node);
 
-	node->status = status;
+	SetWholeNode(node, status, level_counter);
 	node->child[0] = NULL;
 	node->child[1] = NULL;
 }
 
-static int InitChildrenNodes(btrie_node_t *node)
+/*returns a pair of nodes from the free list, NULL if a new slab failed*/
+static btrie_node_t *AllocPair(btrie_t *trie)
 {
-	btrie_node_t *node1 = NULL;
-	btrie_node_t *node2 = NULL;
+	struct btrie_slab_t *slab = NULL;
+	btrie_node_t *pair = NULL;
+	size_t i = 0;
 
-	assert(node);
-
-	node1 = malloc(sizeof(btrie_node_t));
-	if (NULL == node1)
+	if (NULL == trie->free_pairs)
 	{
-		return MALLOC_FAIL;
+		slab = malloc(sizeof(struct btrie_slab_t));
+		if (NULL == slab)
+		{
+			return NULL;
+		}
+
+		slab->next = trie->slabs;
+		trie->slabs = slab;
+		++trie->num_of_slabs;
+
+		for (i = 0; i < 2 * PAIRS_PER_SLAB; i += 2)
+		{
+			slab->nodes[i].child[0] = trie->free_pairs;
+			trie->free_pairs = &slab->nodes[i];
+		}
 	}
-	
-	node2 = malloc(sizeof(btrie_node_t));
-	if (NULL == node2)
+
+	pair = trie->free_pairs;
+	trie->free_pairs = pair->child[0];
+
+	return pair;
+}
+
+static void ReleasePair(btrie_t *trie, btrie_node_t *pair)
+{
+	pair->child[0] = trie->free_pairs;
+	trie->free_pairs = pair;
+}
+
+static int InitChildrenNodes(btrie_t *trie, btrie_node_t *node,
+														size_t level_counter)
+{
+	btrie_node_t *pair = NULL;
+
+	assert(node);
+
+	pair = AllocPair(trie);
+	if (NULL == pair)
 	{
-		free(node1);
 		return MALLOC_FAIL;
 	}
 
-	InitNode(node1, node->status);
-	InitNode(node2, node->status);
+	InitNode(&pair[0], node->status, level_counter - 1);
+	InitNode(&pair[1], node->status, level_counter - 1);
 
-	node->child[0] = node1;
-	node->child[1] = node2;
+	node->child[0] = &pair[0];
+	node->child[1] = &pair[1];
+	trie->num_of_nodes += 2;
 
 	return SUCCESS;
 }
 
-static void FreeChildren(btrie_node_t *node)
+static void FreeChildren(btrie_t *trie, btrie_node_t *node)
 {
-	free(node->child[0]);
-	free(node->child[1]);
+	ReleasePair(trie, node->child[0]);
 	node->child[0] = NULL;
 	node->child[1] = NULL;
+	trie->num_of_nodes -= 2;
 }
 
 btrie_t *BTrieCreate(size_t bit_size_limit)
@@ -99,97 +161,156 @@ btrie_t *BTrieCreate(size_t bit_size_limit)
 	}
 
 	trie->bit_size_limit = bit_size_limit;
-	trie->max_addresses = PowerOfTwo(bit_size_limit) - 1;
-	trie->root->child[0] = NULL;
-	trie->root->child[1] = NULL;
-	trie->root->status = VACANT_BELOW_NODE;
+	trie->max_addresses = ((size_t)1 << bit_size_limit) - 1;
+	trie->num_of_nodes = 1;
+	trie->slabs = NULL;
+	trie->free_pairs = NULL;
+	trie->num_of_slabs = 0;
+	InitNode(trie->root, VACANT_BELOW_NODE, bit_size_limit);
 
 	return trie;
 }
 
-static void BTrieDestroyNodesRec(btrie_node_t *node)
+/*
+* gives every pair below node back to the free list, with an explicit stack
+* of the pairs still to visit: each visit pushes at most two, so the stack
+* never holds more than two per level.
+*/
+static void FreeSubtree(btrie_t *trie, btrie_node_t *node)
 {
-	assert(node);
+	btrie_node_t *stack[2 * MAX_BITS];
+	btrie_node_t *pair = NULL;
+	size_t depth = 0;
+	int i = 0;
 
-	if (NULL != node->child[0])
+	if (ISLEAF(node))
 	{
-		BTrieDestroyNodesRec(node->child[0]);
+		return;
 	}
 
-	if (NULL != node->child[1])
+	stack[depth++] = node->child[0];
+	node->child[0] = NULL;
+	node->child[1] = NULL;
+
+	while (depth > 0)
 	{
-		BTrieDestroyNodesRec(node->child[1]);
-	}
+		pair = stack[--depth];
+		for (i = 0; i < 2; ++i)
+		{
+			if (!ISLEAF(&pair[i]))
+			{
+				assert(depth < 2 * MAX_BITS);
+				stack[depth++] = pair[i].child[0];
+			}
+		}
 
-	free(node);
-	node = NULL;
+		ReleasePair(trie, pair);
+		trie->num_of_nodes -= 2;
+	}
 }
 
+/*every node but the root lives in a slab, so no walk is needed*/
 void BTrieDestroy(btrie_t *trie)
 {
+	struct btrie_slab_t *next = NULL;
+
 	assert(trie);
 
-	BTrieDestroyNodesRec(trie->root);
+	while (NULL != trie->slabs)
+	{
+		next = trie->slabs->next;
+		free(trie->slabs);
+		trie->slabs = next;
+	}
 
+	free(trie->root);
 	free(trie);
 	trie = NULL;
 }
 
-static void UpdateNodeStatus(btrie_node_t *node)
+static void UpdateNodeStatus(btrie_t *trie, btrie_node_t *node)
 {
 	if (!ISLEAF(node))
 	{
+		node->vacant_count = node->child[0]->vacant_count +
+											node->child[1]->vacant_count;
+
 		if ((FULL_OCCUPANCY_BELOW_NODE == node->child[0]->status) &&
 			(FULL_OCCUPANCY_BELOW_NODE == node->child[1]->status))
 		{
 			node->status = FULL_OCCUPANCY_BELOW_NODE;
-			FreeChildren(node);
+			node->largest_vacant_block = NO_VACANT_BLOCK;
+			FreeChildren(trie, node);
 		}
 		else if ((VACANT_BELOW_NODE == node->child[0]->status) &&
 			   (VACANT_BELOW_NODE == node->child[1]->status))
 		{
 			node->status = VACANT_BELOW_NODE;
-			FreeChildren(node);
+			node->largest_vacant_block =
+								node->child[0]->largest_vacant_block + 1;
+			FreeChildren(trie, node);
 		}
 		else
 		{
 			node->status = PARTIAL_OCCUPANCY_BELOW_NODE;
+			node->largest_vacant_block =
+								MAX(node->child[0]->largest_vacant_block,
+									node->child[1]->largest_vacant_block);
 		}
 	}
 }
 
-static int BTrieInsertOrRemoveRec(btrie_node_t *node, unsigned int data,
-										size_t level_counter, int param)
+/*
+* sets the block of 2^block_bits addresses that holds data to param (FULL or
+* VACANT). the whole block must be in the other state, or STATUS_FAIL.
+* walks down keeping the path, then updates the statuses back up it.
+*/
+static int SetBlock(btrie_t *trie, unsigned int data, int param,
+															size_t block_bits)
 {
-	int res = 0;
-	int child_number = 0;
-
-	assert(NULL != node);
-
-	if (param == node->status)
-	{
-		return STATUS_FAIL;
-	}
+	btrie_node_t *path[MAX_BITS];
+	btrie_node_t *node = trie->root;
+	size_t level_counter = trie->bit_size_limit, depth = 0;
+	int res = SUCCESS;
 
-	if (0 == level_counter)
+	for (;;)
 	{
-		node->status = param;
+		if (param == node->status)
+		{
+			res = STATUS_FAIL;
+			break;
+		}
 
-		return SUCCESS;
-	}
+		if (block_bits == level_counter)
+		{
+			if (PARTIAL_OCCUPANCY_BELOW_NODE == node->status)
+			{
+				res = STATUS_FAIL;
+				break;
+			}
+
+			SetWholeNode(node, param, level_counter);
+			break;
+		}
 
-	if (ISLEAF(node))
-	{
-		if (MALLOC_FAIL == InitChildrenNodes(node))
+		if (ISLEAF(node))
 		{
-			return MALLOC_FAIL;
+			if (MALLOC_FAIL == InitChildrenNodes(trie, node, level_counter))
+			{
+				res = MALLOC_FAIL;
+				break;
+			}
 		}
+
+		path[depth++] = node;
+		--level_counter;
+		node = node->child[(data >> level_counter) & 1];
 	}
-	child_number = ((data >> (level_counter - 1))) & 1;
-	res = BTrieInsertOrRemoveRec(node->child[child_number], data,
-													level_counter - 1, param);
 
-	UpdateNodeStatus(node);
+	while (depth > 0)
+	{
+		UpdateNodeStatus(trie, path[--depth]);
+	}
 
 	return res;
 }
@@ -198,135 +319,373 @@ int BTrieInsert(btrie_t *trie, unsigned int data)
 {
 	assert(NULL != trie);
 
-	data = (data << trie->bit_size_limit);
-	data = (data >> trie->bit_size_limit);
+	data &= ADDRESS_MASK(trie);
 
-	return BTrieInsertOrRemoveRec(trie->root, data, trie->bit_size_limit, 
-													FULL_OCCUPANCY_BELOW_NODE);
+	return SetBlock(trie, data, FULL_OCCUPANCY_BELOW_NODE, 0);
 }
 
 int BTrieFreeNode(btrie_t *trie, unsigned int data)
 {
 	assert(NULL != trie);
 
-	data = (data << trie->bit_size_limit);
-	data = (data >> trie->bit_size_limit);
+	data &= ADDRESS_MASK(trie);
 	
-	return BTrieInsertOrRemoveRec(trie->root, data, trie->bit_size_limit, 
-															VACANT_BELOW_NODE);
+	return SetBlock(trie, data, VACANT_BELOW_NODE, 0);
 }
 
-static unsigned int BTrieGetNewNodeRec(btrie_node_t *node, unsigned int data,
-														size_t level_counter)
+/*
+* receives a trie, the block size as a power of two, and where to put the
+* block's first address.
+* takes the lowest vacant block of 2^block_bits addresses that starts at a
+* multiple of its size, like a buddy allocator. every node knows its largest
+* vacant block, so one descent finds it and another marks it FULL.
+* returns SUCCESS, STATUS_FAIL if there is no such block, or MALLOC_FAIL.
+* O(bit_size_limit).
+*/
+int BTrieAllocBlock(btrie_t *trie, size_t block_bits, unsigned int *data)
 {
-	if (0 == level_counter)
-	{
-		return data;
-	}
+	btrie_node_t *node = NULL;
+	size_t level_counter = 0;
+	int child_number = 0, res = 0;
+	unsigned int block = 0;
+
+	assert(NULL != trie);
+	assert(NULL != data);
+	assert(block_bits <= trie->bit_size_limit);
 
-	--level_counter;
-	if (PARTIAL_OCCUPANCY_BELOW_NODE == node->child[0]->status)
+	node = trie->root;
+	if (node->largest_vacant_block < (int)block_bits)
 	{
-		return BTrieGetNewNodeRec(node->child[0], data, level_counter);
+		return STATUS_FAIL;
 	}
-	else if (PARTIAL_OCCUPANCY_BELOW_NODE == node->child[1]->status)
-	{
-		data |= (1<<level_counter);
 
-		return BTrieGetNewNodeRec(node->child[1], data, level_counter);
+	/*the vacant node reached holds the block at its low end*/
+	for (level_counter = trie->bit_size_limit;
+		level_counter > block_bits && VACANT_BELOW_NODE != node->status;
+															--level_counter)
+	{
+		child_number = (node->child[0]->largest_vacant_block <
+														(int)block_bits);
+		block |= (unsigned int)child_number << (level_counter - 1);
+		node = node->child[child_number];
 	}
 
-	if (VACANT_BELOW_NODE == node->child[1]->status)
+	res = SetBlock(trie, block, FULL_OCCUPANCY_BELOW_NODE, block_bits);
+	if (SUCCESS == res)
 	{
-		data |= (1 << level_counter);
+		*data = block;
 	}
 
-	return data;
+	return res;
 }
 
-unsigned int BTrieGetNewNode(btrie_t *trie)
+/*
+* receives a trie, the first address of a block and its size as a power of
+* two, as BTrieAllocBlock gave them.
+* marks the whole block vacant again, merging it with vacant neighbours.
+* returns SUCCESS, STATUS_FAIL if the block was not wholly taken, or
+* MALLOC_FAIL.
+* O(bit_size_limit).
+*/
+int BTrieFreeBlock(btrie_t *trie, unsigned int data, size_t block_bits)
 {
-	unsigned int data = 0;
-
 	assert(NULL != trie);
+	assert(block_bits <= trie->bit_size_limit);
+
+	data &= ADDRESS_MASK(trie);
+	assert(0 == (data & (unsigned int)(((size_t)1 << block_bits) - 1)));
+
+	return SetBlock(trie, data, VACANT_BELOW_NODE, block_bits);
+}
 
-	if (FULL_OCCUPANCY_BELOW_NODE == trie->root->status)
+/*
+* sets every address from low to high to param. covered subtrees are set
+* whole and lose their children, so only the two edge paths split. a
+* depth-first walk with an explicit stack of the current path, where stage
+* says which children of a node were done, so each node is updated after
+* both its halves.
+*/
+static int SetRange(btrie_t *trie, size_t low, size_t high, int param)
+{
+	range_frame_t stack[MAX_BITS + 1];
+	range_frame_t *frame = NULL;
+	size_t depth = 0, span = 0, half = 0;
+	int res = SUCCESS;
+
+	stack[0].node = trie->root;
+	stack[0].node_low = 0;
+	stack[0].level_counter = trie->bit_size_limit;
+	stack[0].stage = 0;
+	depth = 1;
+
+	while (depth > 0 && SUCCESS == res)
 	{
-		return -1;
+		frame = &stack[depth - 1];
+		span = (size_t)1 << frame->level_counter;
+		half = span / 2;
+
+		if (0 == frame->stage)
+		{
+			if (param == frame->node->status)
+			{
+				--depth;
+				continue;
+			}
+
+			if (low <= frame->node_low && frame->node_low + span - 1 <= high)
+			{
+				FreeSubtree(trie, frame->node);
+				SetWholeNode(frame->node, param, frame->level_counter);
+				--depth;
+				continue;
+			}
+
+			if (ISLEAF(frame->node))
+			{
+				res = InitChildrenNodes(trie, frame->node,
+													frame->level_counter);
+				if (SUCCESS != res)
+				{
+					break;
+				}
+			}
+		}
+
+		++frame->stage;
+		if ((1 == frame->stage && low < frame->node_low + half) ||
+			(2 == frame->stage && frame->node_low + half <= high))
+		{
+			stack[depth].node = frame->node->child[frame->stage - 1];
+			stack[depth].node_low = frame->node_low +
+											(frame->stage - 1) * half;
+			stack[depth].level_counter = frame->level_counter - 1;
+			stack[depth].stage = 0;
+			++depth;
+		}
+		else if (2 < frame->stage)
+		{
+			UpdateNodeStatus(trie, frame->node);
+			--depth;
+		}
 	}
 
-	if (VACANT_BELOW_NODE == trie->root->status)
+	/*after a failure, the path above still has to be updated*/
+	while (depth > 0)
 	{
-		return 0;
+		UpdateNodeStatus(trie, stack[--depth].node);
 	}
 
-	return BTrieGetNewNodeRec(trie->root, data, trie->bit_size_limit);
+	return res;
+}
+
+/*
+* receives a trie and the first and last addresses of a range (a CIDR
+* prefix is the range from its address with the host bits off to the same
+* with them on).
+* reserves every address in the range, whatever its state was.
+* returns SUCCESS, or MALLOC_FAIL, in which case only part of the range may
+* be reserved.
+* one traversal: O(bit_size_limit) nodes on the two edges of the range, and
+* O(1) for each covered subtree that had to be freed.
+*/
+int BTrieInsertRange(btrie_t *trie, unsigned int low, unsigned int high)
+{
+	assert(NULL != trie);
+
+	low &= ADDRESS_MASK(trie);
+	high &= ADDRESS_MASK(trie);
+	assert(low <= high);
+
+	return SetRange(trie, low, high, FULL_OCCUPANCY_BELOW_NODE);
 }
 
-static size_t NodeCountRec(btrie_node_t *node)
+/*
+* receives a trie and the first and last addresses of a range.
+* releases every address in the range, whatever its state was.
+* returns SUCCESS, or MALLOC_FAIL, in which case only part of the range may
+* be released.
+* one traversal, like BTrieInsertRange.
+*/
+int BTrieFreeRange(btrie_t *trie, unsigned int low, unsigned int high)
 {
-	size_t counter = 1;
+	assert(NULL != trie);
 
-	assert(NULL != node);
+	low &= ADDRESS_MASK(trie);
+	high &= ADDRESS_MASK(trie);
+	assert(low <= high);
 
-	if (NULL != node->child[0])
+	return SetRange(trie, low, high, VACANT_BELOW_NODE);
+}
+
+/*
+* goes down partial children, the lower one first, and at the bottom takes
+* the vacant child, so partly used subtrees fill up before whole vacant
+* ones are broken.
+*/
+unsigned int BTrieGetNewNode(btrie_t *trie)
+{
+	btrie_node_t *node = NULL;
+	size_t level_counter = 0;
+	unsigned int data = 0;
+
+	assert(NULL != trie);
+
+	node = trie->root;
+	if (FULL_OCCUPANCY_BELOW_NODE == node->status)
 	{
-		counter += NodeCountRec(node->child[0]);
+		return -1;
 	}
 
-	if (NULL != node->child[1])
+	if (VACANT_BELOW_NODE == node->status)
 	{
-		counter += NodeCountRec(node->child[1]);
+		return 0;
 	}
 
-	return counter;
+	for (level_counter = trie->bit_size_limit; level_counter > 0;)
+	{
+		--level_counter;
+		if (PARTIAL_OCCUPANCY_BELOW_NODE == node->child[0]->status)
+		{
+			node = node->child[0];
+		}
+		else if (PARTIAL_OCCUPANCY_BELOW_NODE == node->child[1]->status)
+		{
+			data |= (1U << level_counter);
+			node = node->child[1];
+		}
+		else
+		{
+			if (VACANT_BELOW_NODE == node->child[1]->status)
+			{
+				data |= (1U << level_counter);
+			}
+			break;
+		}
+	}
+
+	return data;
 }
 
+/*
+* receives a trie.
+* returns the number of trie nodes. O(1), kept up to date by every split and
+* collapse.
+*/
 size_t BTrieCount(btrie_t *trie)
 {
 	assert(NULL != trie);
 
-	return NodeCountRec(trie->root);
+	return trie->num_of_nodes;
 }
 
 size_t BTrieMemoryConsumption(btrie_t *trie)
 {
 	assert(NULL != trie);
 
-	return (BTrieCount(trie) * sizeof(btrie_node_t) + sizeof(btrie_t));
+	return (trie->num_of_slabs * sizeof(struct btrie_slab_t) +
+									sizeof(btrie_node_t) + sizeof(btrie_t));
 }
 
-static size_t NodeCountVacantRec(btrie_node_t *node, size_t level_counter)
+/*
+* receives a trie.
+* returns the number of vacant addresses. O(1), every node keeps the count
+* of its subtree.
+*/
+size_t BTrieCountVacant(btrie_t *trie)
 {
-	size_t counter = 0;
-
-	assert(NULL != node);
+	assert(NULL != trie);
 
-	if (VACANT_BELOW_NODE == node->status)
-	{
-		counter += PowerOfTwo(level_counter);
+	return trie->root->vacant_count;
+}
 
-		return counter;
-	}
+/*
+* receives a trie and n.
+* finds the n-th vacant address (counting from 0) without taking it.
+* returns the address, or -1 if there are only n or less vacant addresses.
+* O(bit_size_limit), by the vacant counts.
+*/
+unsigned int BTrieGetNthVacant(btrie_t *trie, size_t n)
+{
+	btrie_node_t *node = NULL;
+	size_t level_counter = 0, data = 0;
 
-	--level_counter;
+	assert(NULL != trie);
 
-	if (NULL != node->child[0])
+	node = trie->root;
+	if (n >= node->vacant_count)
 	{
-		counter += NodeCountVacantRec(node->child[0], level_counter);
+		return -1;
 	}
 
-	if (NULL != node->child[1])
+	for (level_counter = trie->bit_size_limit;
+				PARTIAL_OCCUPANCY_BELOW_NODE == node->status; --level_counter)
 	{
-		counter += NodeCountVacantRec(node->child[1], level_counter);
+		if (n < node->child[0]->vacant_count)
+		{
+			node = node->child[0];
+		}
+		else
+		{
+			n -= node->child[0]->vacant_count;
+			data |= (size_t)1 << (level_counter - 1);
+			node = node->child[1];
+		}
 	}
 
-	return counter;
+	/*a vacant subtree, its n-th address is its n-th vacant one*/
+	return (unsigned int)(data + n);
 }
 
-size_t BTrieCountVacant(btrie_t *trie)
+/*
+* receives a trie and an address.
+* finds the lowest vacant address that is not below data, without taking
+* it, so a client can get back the address it had before.
+* returns the address, or -1 if there is none.
+* O(bit_size_limit): one walk down toward data, remembering the last right
+* sibling with vacant addresses, and if data's own path has none, one walk
+* down that sibling to its lowest vacant address.
+*/
+unsigned int BTrieGetNewNodeFrom(btrie_t *trie, unsigned int data)
 {
+	btrie_node_t *node = NULL, *fallback = NULL;
+	size_t level_counter = 0, fallback_level = 0, fallback_data = 0;
+	int child_number = 0;
+
 	assert(NULL != trie);
 
-	return NodeCountVacantRec(trie->root, trie->bit_size_limit);
-}
\ No newline at end of file
+	data &= ADDRESS_MASK(trie);
+	node = trie->root;
+	for (level_counter = trie->bit_size_limit;
+				PARTIAL_OCCUPANCY_BELOW_NODE == node->status; --level_counter)
+	{
+		child_number = (data >> (level_counter - 1)) & 1;
+		if (0 == child_number && 0 < node->child[1]->vacant_count)
+		{
+			fallback = node->child[1];
+			fallback_level = level_counter - 1;
+			fallback_data = (((size_t)data >> level_counter) << level_counter)
+										| ((size_t)1 << (level_counter - 1));
+		}
+		node = node->child[child_number];
+	}
+
+	if (VACANT_BELOW_NODE == node->status)
+	{
+		return data;
+	}
+
+	if (NULL == fallback)
+	{
+		return -1;
+	}
+
+	for (node = fallback, level_counter = fallback_level;
+				PARTIAL_OCCUPANCY_BELOW_NODE == node->status; --level_counter)
+	{
+		child_number = (0 == node->child[0]->vacant_count);
+		fallback_data |= (size_t)child_number << (level_counter - 1);
+		node = node->child[child_number];
+	}
+
+	return (unsigned int)fallback_data;
+}
@@ -0,0 +1,224 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "barr.h"
+#include "btrie_bitmap.h"
+
+/*
+* flat engine for the btrie allocator contract. the addresses are one bit
+* each in level 0 (on = vacant), and every bit of level i + 1 is on when
+* the matching word of level i has any bit on, up to a single top word. all
+* the levels live in one preallocated buffer, so an allocation is one find
+* first on per level and never mallocs: 4 words for a 24 bit pool.
+*/
+
+#define WORD_INDEX(index) ((index) / LENGTH)
+#define BIT_OFFSET(index) ((index) % LENGTH)
+#define BIT_MASK(index) (1UL << BIT_OFFSET(index))
+#define WORDS_FOR_BITS(bits) (((bits) + LENGTH - 1) / LENGTH)
+#define FULL_WORD (~0UL)
+#define MAX_LEVELS 6 /*ceil(32 / 6) levels cover any unsigned int pool*/
+#define MAX_BIT_SIZE_LIMIT (sizeof(unsigned int) * 8)
+
+enum return_status
+{
+	SUCCESS,
+	MALLOC_FAIL,
+	STATUS_FAIL
+};
+
+struct btrie_bitmap_t
+{
+	size_t bit_size_limit;
+	size_t num_of_addresses;
+	size_t num_of_vacant;
+	size_t num_of_levels;
+	size_t num_of_words;
+	unsigned long *levels[MAX_LEVELS]; /*levels[0] holds the addresses*/
+	unsigned long *words;
+};
+
+/*turns on the first num_of_bits bits of words, the rest stay off*/
+static void SetFirstBits(unsigned long *words, size_t num_of_bits)
+{
+	memset(words, 0xff, WORD_INDEX(num_of_bits) * sizeof(unsigned long));
+	if (0 != BIT_OFFSET(num_of_bits))
+	{
+		words[WORD_INDEX(num_of_bits)] =
+									~(FULL_WORD << BIT_OFFSET(num_of_bits));
+	}
+}
+
+/*
+* receives the number of bits in an address, as BTrieCreate does.
+* creates a pool where all the 2^bit_size_limit addresses are vacant.
+* returns the pool if succeeded, NULL otherwise.
+* O(2^bit_size_limit / 64).
+*/
+btrie_bitmap_t *BTrieBitmapCreate(size_t bit_size_limit)
+{
+	btrie_bitmap_t *trie = NULL;
+	size_t level_bits[MAX_LEVELS];
+	size_t num_of_levels = 0, num_of_words = 0, i = 0;
+
+	assert(0 < bit_size_limit);
+	assert(bit_size_limit <= MAX_BIT_SIZE_LIMIT);
+
+	/*each level has a bit per word of the level below it*/
+	level_bits[0] = (size_t)1 << bit_size_limit;
+	num_of_words = WORDS_FOR_BITS(level_bits[0]);
+	for (num_of_levels = 1; 1 < WORDS_FOR_BITS(level_bits[num_of_levels - 1]);
+															++num_of_levels)
+	{
+		i = num_of_levels;
+		level_bits[i] = WORDS_FOR_BITS(level_bits[i - 1]);
+		num_of_words += WORDS_FOR_BITS(level_bits[i]);
+	}
+
+	trie = malloc(sizeof(btrie_bitmap_t) +
+									num_of_words * sizeof(unsigned long));
+	if (NULL == trie)
+	{
+		return NULL;
+	}
+
+	trie->bit_size_limit = bit_size_limit;
+	trie->num_of_addresses = level_bits[0];
+	trie->num_of_vacant = level_bits[0];
+	trie->num_of_levels = num_of_levels;
+	trie->num_of_words = num_of_words;
+	trie->words = (unsigned long *)((char *)trie + sizeof(btrie_bitmap_t));
+
+	trie->levels[0] = trie->words;
+	SetFirstBits(trie->levels[0], level_bits[0]);
+	for (i = 1; i < num_of_levels; ++i)
+	{
+		trie->levels[i] = trie->levels[i - 1] +
+										WORDS_FOR_BITS(level_bits[i - 1]);
+		SetFirstBits(trie->levels[i], level_bits[i]);
+	}
+
+	return trie;
+}
+
+void BTrieBitmapDestroy(btrie_bitmap_t *trie)
+{
+	assert(trie);
+
+	free(trie);
+}
+
+/*
+* receives a pool and an address.
+* marks the address as taken. a word that runs out of vacant bits turns its
+* bit off in the level above, and so on up.
+* returns SUCCESS, or STATUS_FAIL if it was taken already.
+* O(levels).
+*/
+int BTrieBitmapInsert(btrie_bitmap_t *trie, unsigned int data)
+{
+	size_t index = 0, level = 0;
+
+	assert(trie);
+
+	index = data & (trie->num_of_addresses - 1);
+	if (0 == (trie->levels[0][WORD_INDEX(index)] & BIT_MASK(index)))
+	{
+		return STATUS_FAIL;
+	}
+
+	--trie->num_of_vacant;
+	for (level = 0; level < trie->num_of_levels; ++level)
+	{
+		trie->levels[level][WORD_INDEX(index)] &= ~BIT_MASK(index);
+		if (0 != trie->levels[level][WORD_INDEX(index)])
+		{
+			break;
+		}
+		index = WORD_INDEX(index);
+	}
+
+	return SUCCESS;
+}
+
+/*
+* receives a pool and an address.
+* marks the address as vacant. a word that had no vacant bits turns its bit
+* on in the level above, and so on up.
+* returns SUCCESS, or STATUS_FAIL if it was vacant already.
+* O(levels).
+*/
+int BTrieBitmapFreeNode(btrie_bitmap_t *trie, unsigned int data)
+{
+	size_t index = 0, level = 0;
+	unsigned long old_word = 0;
+
+	assert(trie);
+
+	index = data & (trie->num_of_addresses - 1);
+	if (0 != (trie->levels[0][WORD_INDEX(index)] & BIT_MASK(index)))
+	{
+		return STATUS_FAIL;
+	}
+
+	++trie->num_of_vacant;
+	for (level = 0; level < trie->num_of_levels; ++level)
+	{
+		old_word = trie->levels[level][WORD_INDEX(index)];
+		trie->levels[level][WORD_INDEX(index)] |= BIT_MASK(index);
+		if (0 != old_word)
+		{
+			break;
+		}
+		index = WORD_INDEX(index);
+	}
+
+	return SUCCESS;
+}
+
+/*
+* receives a pool.
+* finds the lowest vacant address without taking it, like BTrieGetNewNode.
+* returns the address, or (unsigned int)-1 if the pool is full.
+* O(levels): one find first on per level, from the top word down.
+*/
+unsigned int BTrieBitmapGetNewNode(const btrie_bitmap_t *trie)
+{
+	size_t index = 0, level = 0;
+
+	assert(trie);
+
+	if (0 == trie->num_of_vacant)
+	{
+		return -1;
+	}
+
+	for (level = trie->num_of_levels; level-- > 0;)
+	{
+		index = index * LENGTH +
+						BitsArrayFindFirstOn(trie->levels[level][index]);
+	}
+
+	return (unsigned int)index;
+}
+
+/*
+* receives a pool.
+* returns the number of vacant addresses.
+* O(1), the count is kept up to date by insert and free.
+*/
+size_t BTrieBitmapCountVacant(const btrie_bitmap_t *trie)
+{
+	assert(trie);
+
+	return trie->num_of_vacant;
+}
+
+size_t BTrieBitmapMemoryConsumption(const btrie_bitmap_t *trie)
+{
+	assert(trie);
+
+	return (sizeof(btrie_bitmap_t) +
+								trie->num_of_words * sizeof(unsigned long));
+}
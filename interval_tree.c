@@ -0,0 +1,600 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "interval_tree.h"
+
+/*WITHOUT USING RECURSION*/
+
+/*
+*	Red-black tree of closed intervals [low, high], ordered by low. every
+*	node also keeps the largest high of its subtree, so a search can skip
+*	any subtree that ends before the query starts. endpoints are user
+*	pointers compared with cmp_func, like the datas of bstree.
+*/
+
+#define PARENT(node) (node)->parent
+#define PARAM tree->param
+#define ISBIGGERCHILD(node) (PARENT(node)->child[1] == node)
+#define ROOT tree->root.child[0]
+#define ISRED(node) ((node) && RED == (node)->color)
+#define ISBLACK(node) (!ISRED(node))
+#define COMPARE(point1, point2) tree->cmp_func((point1), (point2), PARAM)
+#define MAX_DEPTH (sizeof(size_t) * 8 * 2) /*red-black height bound*/
+
+enum node_color
+{
+	RED,
+	BLACK
+};
+
+typedef struct interval_node_t interval_node_t;
+
+struct interval_node_t
+{
+	interval_node_t *parent;
+	interval_node_t *child[2]; /*0 = left(smaller low), 1 = right*/
+	const void *low;
+	const void *high;
+	const void *max_high; /*largest high in this subtree*/
+	void *data;
+	int color;
+};
+
+struct interval_tree_t
+{
+	interval_node_t root; /*sentinel, must stay first, see TreeOfNode*/
+	compare_func_t cmp_func;
+	void *param;
+	size_t num_of_elements;
+};
+
+/*
+*	This function creates an empty interval tree.
+*	Arguements = endpoint comparator, user parameters.
+*	Return value - tree handle, NULL on failure.
+*/
+interval_tree_t *IntervalTreeCreate(compare_func_t cmp_func, void *param)
+{
+	interval_tree_t *tree = NULL;
+
+	assert(cmp_func);
+
+	tree = malloc(sizeof(interval_tree_t));
+	if (!tree)
+	{
+		return NULL;
+	}
+
+	tree->root.parent = NULL;
+	tree->root.child[0] = NULL;
+	tree->root.child[1] = NULL;
+	tree->root.low = NULL;
+	tree->root.high = NULL;
+	tree->root.max_high = NULL;
+	tree->root.data = NULL;
+	tree->root.color = BLACK;
+	tree->cmp_func = cmp_func;
+	tree->param = param;
+	tree->num_of_elements = 0;
+
+	return tree;
+}
+
+/*
+*	This function frees the tree and its nodes (not the endpoints or datas).
+*	Arguments - tree handle.
+*/
+void IntervalTreeDestroy(interval_tree_t *tree)
+{
+	interval_node_t *node = NULL, *parent = NULL;
+
+	assert(tree);
+
+	node = ROOT;
+	while (node && node != &tree->root)
+	{
+		if (node->child[0])
+		{
+			node = node->child[0];
+		}
+		else if (node->child[1])
+		{
+			node = node->child[1];
+		}
+		else
+		{
+			parent = PARENT(node);
+			parent->child[ISBIGGERCHILD(node)] = NULL;
+			free(node);
+			node = parent;
+		}
+	}
+
+	free(tree);
+	tree = NULL;
+}
+
+static interval_tree_t *TreeOfNode(interval_node_t *node)
+{
+	while (PARENT(node))
+	{
+		node = PARENT(node);
+	}
+
+	return ((interval_tree_t *)node);
+}
+
+/*recomputes node->max_high from node->high and its children*/
+static void UpdateMax(const interval_tree_t *tree, interval_node_t *node)
+{
+	int side = 0;
+
+	node->max_high = node->high;
+	for (side = 0; side < 2; ++side)
+	{
+		if (node->child[side] &&
+			COMPARE(node->child[side]->max_high, node->max_high) > 0)
+		{
+			node->max_high = node->child[side]->max_high;
+		}
+	}
+}
+
+/*recomputes max_high from node up to the real root*/
+static void UpdateMaxUp(const interval_tree_t *tree, interval_node_t *node)
+{
+	for (; node != &tree->root; node = PARENT(node))
+	{
+		UpdateMax(tree, node);
+	}
+}
+
+/*
+*	Brings node->child[!side] up into node's place, and moves node down to
+*	its side. the pivot now spans node's old subtree.
+*/
+static void Rotate(const interval_tree_t *tree, interval_node_t *node,
+																	int side)
+{
+	interval_node_t *pivot = node->child[!side];
+
+	node->child[!side] = pivot->child[side];
+	if (pivot->child[side])
+	{
+		PARENT(pivot->child[side]) = node;
+	}
+
+	PARENT(pivot) = PARENT(node);
+	PARENT(node)->child[ISBIGGERCHILD(node)] = pivot;
+	pivot->child[side] = node;
+	PARENT(node) = pivot;
+
+	pivot->max_high = node->max_high;
+	UpdateMax(tree, node);
+}
+
+static void InsertFixup(interval_tree_t *tree, interval_node_t *node)
+{
+	interval_node_t *parent = NULL, *grandparent = NULL, *uncle = NULL;
+	int side = 0;
+
+	while (ISRED(PARENT(node)))
+	{
+		parent = PARENT(node);
+		grandparent = PARENT(parent);
+		side = ISBIGGERCHILD(parent);
+		uncle = grandparent->child[!side];
+
+		if (ISRED(uncle))
+		{
+			parent->color = BLACK;
+			uncle->color = BLACK;
+			grandparent->color = RED;
+			node = grandparent;
+		}
+		else
+		{
+			if (node == parent->child[!side])
+			{
+				node = parent;
+				Rotate(tree, node, side);
+				parent = PARENT(node);
+			}
+
+			parent->color = BLACK;
+			grandparent->color = RED;
+			Rotate(tree, grandparent, !side);
+		}
+	}
+
+	ROOT->color = BLACK;
+}
+
+/*
+*	the child that took the removed black node's place (possibly NULL) is
+*	one black short; push the deficit up or fix it with rotations.
+*/
+static void RemoveFixup(interval_tree_t *tree, interval_node_t *node,
+													interval_node_t *parent)
+{
+	interval_node_t *sibling = NULL;
+	int side = 0;
+
+	while (node != ROOT && ISBLACK(node))
+	{
+		side = (parent->child[1] == node);
+		sibling = parent->child[!side];
+
+		if (ISRED(sibling))
+		{
+			sibling->color = BLACK;
+			parent->color = RED;
+			Rotate(tree, parent, side);
+			sibling = parent->child[!side];
+		}
+
+		if (ISBLACK(sibling->child[0]) && ISBLACK(sibling->child[1]))
+		{
+			sibling->color = RED;
+			node = parent;
+			parent = PARENT(node);
+		}
+		else
+		{
+			if (ISBLACK(sibling->child[!side]))
+			{
+				sibling->child[side]->color = BLACK;
+				sibling->color = RED;
+				Rotate(tree, sibling, !side);
+				sibling = parent->child[!side];
+			}
+
+			sibling->color = parent->color;
+			parent->color = BLACK;
+			sibling->child[!side]->color = BLACK;
+			Rotate(tree, parent, side);
+			node = ROOT;
+		}
+	}
+
+	if (node)
+	{
+		node->color = BLACK;
+	}
+}
+
+/*puts new_node (possibly NULL) in old_node's place under its parent*/
+static void Transplant(interval_node_t *old_node, interval_node_t *new_node)
+{
+	PARENT(old_node)->child[ISBIGGERCHILD(old_node)] = new_node;
+	if (new_node)
+	{
+		PARENT(new_node) = PARENT(old_node);
+	}
+}
+
+/*
+*	return value - iter to the new interval, IntervalTreeEnd on failure.
+*	arguments - tree handle, endpoints (low must not be above high), data
+*	kept beside them. the endpoints are compared, not copied, and must stay
+*	valid while the interval is in the tree.
+*	O(log n).
+*/
+it_iter IntervalTreeInsert(interval_tree_t *tree, const void *low,
+												const void *high, void *data)
+{
+	interval_node_t *node = NULL, *node_parent = NULL;
+	int side = 0;
+
+	assert(tree);
+	assert(low);
+	assert(high);
+	assert(COMPARE(low, high) <= 0);
+
+	node = malloc(sizeof(interval_node_t));
+	if (!node)
+	{
+		return IntervalTreeEnd(tree);
+	}
+
+	node->child[0] = NULL;
+	node->child[1] = NULL;
+	node->low = low;
+	node->high = high;
+	node->max_high = high;
+	node->data = data;
+	node->color = RED;
+
+	/*every max on the way down grows to cover high*/
+	node_parent = &tree->root;
+	side = 0;
+	while (node_parent->child[side])
+	{
+		node_parent = node_parent->child[side];
+		if (COMPARE(high, node_parent->max_high) > 0)
+		{
+			node_parent->max_high = high;
+		}
+		side = (COMPARE(low, node_parent->low) > 0);
+	}
+
+	node_parent->child[side] = node;
+	PARENT(node) = node_parent;
+	++tree->num_of_elements;
+
+	InsertFixup(tree, node);
+
+	return ((it_iter)node);
+}
+
+/*
+*	return value - the removed interval's data.
+*	arguments - tree iter (not IntervalTreeEnd).
+*	O(log n).
+*/
+void *IntervalTreeRemove(it_iter iter)
+{
+	interval_tree_t *tree = NULL;
+	interval_node_t *target_node = NULL, *successor = NULL;
+	interval_node_t *moved_up = NULL, *moved_up_parent = NULL;
+	void *data = NULL;
+	int removed_color = 0;
+
+	assert(iter);
+
+	target_node = (interval_node_t *)iter;
+	tree = TreeOfNode(target_node);
+	assert(target_node != &tree->root);
+
+	data = target_node->data;
+	removed_color = target_node->color;
+
+	if (!(target_node->child[0] && target_node->child[1]))
+	{
+		moved_up = target_node->child[NULL != target_node->child[1]];
+		moved_up_parent = PARENT(target_node);
+		Transplant(target_node, moved_up);
+	}
+	else
+	{
+		/*the successor (no left child) takes the target's place*/
+		successor = (interval_node_t *)IntervalTreeNext(iter);
+		removed_color = successor->color;
+		moved_up = successor->child[1];
+
+		if (PARENT(successor) == target_node)
+		{
+			moved_up_parent = successor;
+		}
+		else
+		{
+			moved_up_parent = PARENT(successor);
+			Transplant(successor, moved_up);
+			successor->child[1] = target_node->child[1];
+			PARENT(successor->child[1]) = successor;
+		}
+
+		Transplant(target_node, successor);
+		successor->child[0] = target_node->child[0];
+		PARENT(successor->child[0]) = successor;
+		successor->color = target_node->color;
+	}
+
+	free(target_node);
+	--tree->num_of_elements;
+
+	/*the successor, if it moved, is on this path too*/
+	UpdateMaxUp(tree, moved_up_parent);
+
+	if (BLACK == removed_color)
+	{
+		RemoveFixup(tree, moved_up, moved_up_parent);
+	}
+
+	return data;
+}
+
+#define OVERLAPS(node, low, high) (COMPARE((node)->low, (high)) <= 0 && \
+									COMPARE((low), (node)->high) <= 0)
+
+/*
+*	return value - iter to an interval that overlaps [low, high], or
+*	IntervalTreeEnd if none does.
+*	arguments - tree handle, query endpoints.
+*	goes left whenever the left subtree reaches low, since then either it
+*	holds an overlap or nothing to the right starts early enough. O(log n).
+*/
+it_iter IntervalTreeFindOverlap(interval_tree_t *tree, const void *low,
+															const void *high)
+{
+	interval_node_t *node = NULL;
+
+	assert(tree);
+
+	node = ROOT;
+	while (node && !OVERLAPS(node, low, high))
+	{
+		if (node->child[0] && COMPARE(node->child[0]->max_high, low) >= 0)
+		{
+			node = node->child[0];
+		}
+		else
+		{
+			node = node->child[1];
+		}
+	}
+
+	return (node ? (it_iter)node : IntervalTreeEnd(tree));
+}
+
+/*
+*	return value - 0 if every action succeeded, 1 if one failed.
+*	arguments - tree handle, query endpoints, action function, param
+*	this function performs the given action for the data of every interval
+*	that overlaps [low, high], by order of low. subtrees that end before low
+*	are skipped and the walk stops at the first interval that starts after
+*	high, so only the paths down to the k overlaps are read:
+*	O(log n + k log(n / k)), O(log n + k) when the overlaps are clustered.
+*/
+int IntervalTreeForEachOverlap(interval_tree_t *tree, const void *low,
+							const void *high, action_func_t act_func,
+																void *param)
+{
+	interval_node_t *stack[MAX_DEPTH];
+	interval_node_t *node = NULL;
+	size_t depth = 0;
+	int func_result = 0;
+
+	assert(tree);
+	assert(act_func);
+
+	node = ROOT;
+	while (!func_result)
+	{
+		while (node && COMPARE(node->max_high, low) >= 0)
+		{
+			assert(depth < MAX_DEPTH);
+			stack[depth++] = node;
+			node = node->child[0];
+		}
+
+		if (0 == depth)
+		{
+			break;
+		}
+
+		node = stack[--depth];
+		if (COMPARE(node->low, high) > 0)
+		{
+			break;
+		}
+
+		if (COMPARE(low, node->high) <= 0)
+		{
+			func_result = act_func(node->data, param);
+		}
+		node = node->child[1];
+	}
+
+	return (0 != func_result);
+}
+
+static int CountAction(void *data, void *param)
+{
+	(void)data;
+	++*(size_t *)param;
+
+	return 0;
+}
+
+/*
+*	return value - number of intervals that overlap [low, high].
+*	arguments - tree handle, query endpoints.
+*/
+size_t IntervalTreeCountOverlaps(interval_tree_t *tree, const void *low,
+															const void *high)
+{
+	size_t counter = 0;
+
+	IntervalTreeForEachOverlap(tree, low, high, CountAction, &counter);
+
+	return counter;
+}
+
+size_t IntervalTreeCount(const interval_tree_t *tree)
+{
+	assert(tree);
+
+	return tree->num_of_elements;
+}
+
+int IntervalTreeIsEmpty(const interval_tree_t *tree)
+{
+	assert(tree);
+
+	return (ROOT ? 0 : 1);
+}
+
+/*
+*	return value - iter to the interval with the smallest low, or
+*	IntervalTreeEnd if the tree is empty.
+*/
+it_iter IntervalTreeBegin(interval_tree_t *tree)
+{
+	interval_node_t *node = NULL;
+
+	assert(tree);
+
+	node = &tree->root;
+	while (node->child[0])
+	{
+		node = node->child[0];
+	}
+
+	return ((it_iter)node);
+}
+
+it_iter IntervalTreeEnd(interval_tree_t *tree)
+{
+	assert(tree);
+
+	return ((it_iter)&tree->root);
+}
+
+/*
+*	return value - next iterator, by order of low.
+*	arguments - tree iter (not IntervalTreeEnd).
+*/
+it_iter IntervalTreeNext(it_iter iter)
+{
+	interval_node_t *node = NULL;
+
+	assert(iter);
+
+	node = (interval_node_t *)iter;
+	if (node->child[1])
+	{
+		node = node->child[1];
+		while (node->child[0])
+		{
+			node = node->child[0];
+		}
+
+		return ((it_iter)node);
+	}
+
+	while (ISBIGGERCHILD(node))
+	{
+		node = PARENT(node);
+	}
+
+	return ((it_iter)PARENT(node));
+}
+
+void *IntervalTreeGetData(it_iter iter)
+{
+	assert(iter);
+
+	return (((interval_node_t *)iter)->data);
+}
+
+const void *IntervalTreeGetLow(it_iter iter)
+{
+	assert(iter);
+
+	return (((interval_node_t *)iter)->low);
+}
+
+const void *IntervalTreeGetHigh(it_iter iter)
+{
+	assert(iter);
+
+	return (((interval_node_t *)iter)->high);
+}
+
+int IntervalTreeIsSameIter(it_iter iter1, it_iter iter2)
+{
+	assert(iter1);
+	assert(iter2);
+
+	return (iter1 == iter2);
+}
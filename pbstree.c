@@ -0,0 +1,545 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "pbstree.h"
+
+/*WITHOUT USING RECURSION*/
+
+/*
+*	Persistent BST: every version is immutable. an insert or remove copies
+*	the nodes on one root to leaf path (plus the few a rotation touches) and
+*	shares every other node with the version it started from, so each write
+*	makes O(log n) nodes. the tree is an AVL tree, which bounds the path
+*	length the explicit stacks below need.
+*	nodes are reference counted by their parents and versions by their
+*	holders, so a reader that acquired a version can walk it without locks
+*	while the writer publishes new ones. the datas are not copied, and must
+*	outlive every version that holds them.
+*/
+#ifndef __GNUC__
+#error "pbstree.c needs the __atomic builtins (gcc or clang)"
+#endif
+
+#define MAX_HEIGHT 96 /*an AVL tree of 2^64 nodes is shorter than 93*/
+#define HEIGHT(node) ((node) ? (node)->height : 0)
+#define MAX(a,b) (((a)>(b))? (a):(b))
+#define INC_REF(counter) __atomic_add_fetch(&(counter), 1, __ATOMIC_RELAXED)
+#define DEC_REF(counter) __atomic_sub_fetch(&(counter), 1, __ATOMIC_ACQ_REL)
+
+enum return_status
+{
+	SUCCESS,
+	MALLOC_FAIL
+};
+
+typedef struct pbst_node_t pbst_node_t;
+
+struct pbst_node_t
+{
+	pbst_node_t *child[2]; /*0 = left(smaller), 1 = right (larger)*/
+	void *data;
+	size_t ref_count; /*parents and versions pointing here*/
+	size_t height;
+};
+
+struct pbs_tree_t
+{
+	pbst_node_t *root;
+	size_t num_of_elements;
+	compare_func_t cmp_func;
+	void *param;
+	size_t ref_count; /*holders of this version*/
+};
+
+/*the nodes from a root down, and the side taken at each*/
+typedef struct path_t
+{
+	pbst_node_t *node[MAX_HEIGHT];
+	int side[MAX_HEIGHT];
+	size_t depth;
+} path_t;
+
+static pbs_tree_t *CreateVersion(const pbs_tree_t *base, pbst_node_t *root,
+													size_t num_of_elements)
+{
+	pbs_tree_t *version = malloc(sizeof(pbs_tree_t));
+
+	if (version)
+	{
+		version->root = root;
+		version->num_of_elements = num_of_elements;
+		version->cmp_func = base->cmp_func;
+		version->param = base->param;
+		version->ref_count = 1;
+	}
+
+	return version;
+}
+
+/*
+*	This function creates an empty version.
+*	Arguements = comparator, user parameters.
+*	Return value - version handle (held once by the caller), NULL on failure.
+*/
+pbs_tree_t *PbstCreate(compare_func_t cmp_func, void *param)
+{
+	pbs_tree_t base;
+
+	assert(cmp_func);
+
+	base.cmp_func = cmp_func;
+	base.param = param;
+
+	return CreateVersion(&base, NULL, 0);
+}
+
+/*drops one reference to node, freeing every node left unreferenced*/
+static void Unref(pbst_node_t *node)
+{
+	pbst_node_t *pending = NULL, *child = NULL;
+	int side = 0;
+
+	if (node && 0 == DEC_REF(node->ref_count))
+	{
+		/*freed nodes wait in a list linked through their data slot*/
+		node->data = NULL;
+		pending = node;
+	}
+
+	while (pending)
+	{
+		node = pending;
+		pending = (pbst_node_t *)node->data;
+
+		for (side = 0; side < 2; ++side)
+		{
+			child = node->child[side];
+			if (child && 0 == DEC_REF(child->ref_count))
+			{
+				child->data = pending;
+				pending = child;
+			}
+		}
+
+		free(node);
+	}
+}
+
+/*
+*	return value - the same version handle.
+*	arguments - version handle.
+*	The function takes one more hold of a version: an O(1) snapshot that
+*	stays readable until it is released, whatever is written later.
+*/
+pbs_tree_t *PbstAcquire(pbs_tree_t *version)
+{
+	assert(version);
+
+	INC_REF(version->ref_count);
+
+	return version;
+}
+
+/*
+*	return value - none.
+*	arguments - version handle.
+*	The function drops one hold of a version. the last one frees it, and the
+*	nodes no other version shares.
+*/
+void PbstRelease(pbs_tree_t *version)
+{
+	assert(version);
+
+	if (0 == DEC_REF(version->ref_count))
+	{
+		Unref(version->root);
+		free(version);
+	}
+}
+
+static pbst_node_t *CreateNode(void *data, pbst_node_t *left,
+														pbst_node_t *right)
+{
+	pbst_node_t *node = malloc(sizeof(pbst_node_t));
+
+	if (node)
+	{
+		node->data = data;
+		node->child[0] = left;
+		node->child[1] = right;
+		node->ref_count = 1;
+		node->height = 1 + MAX(HEIGHT(left), HEIGHT(right));
+	}
+
+	return node;
+}
+
+/*
+*	a private copy of a shared node, taking over the caller's reference to
+*	it. the copy references the same children.
+*/
+static pbst_node_t *Own(pbst_node_t *node)
+{
+	pbst_node_t *copy = CreateNode(node->data, node->child[0], node->child[1]);
+
+	if (copy)
+	{
+		if (copy->child[0])
+		{
+			INC_REF(copy->child[0]->ref_count);
+		}
+		if (copy->child[1])
+		{
+			INC_REF(copy->child[1]->ref_count);
+		}
+		Unref(node);
+	}
+
+	return copy;
+}
+
+static void UpdateHeight(pbst_node_t *node)
+{
+	node->height = 1 + MAX(HEIGHT(node->child[0]), HEIGHT(node->child[1]));
+}
+
+/*
+*	brings node->child[side] up into node's place. node must be private,
+*	the child is copied if needed. returns the new subtree root.
+*/
+static pbst_node_t *RotateUp(pbst_node_t *node, int side)
+{
+	pbst_node_t *pivot = Own(node->child[side]);
+
+	if (!pivot)
+	{
+		return NULL;
+	}
+
+	node->child[side] = pivot->child[!side];
+	pivot->child[!side] = node;
+	UpdateHeight(node);
+	UpdateHeight(pivot);
+
+	return pivot;
+}
+
+/*
+*	restores the AVL balance of a private node whose subtrees differ in
+*	height by 2 at most. returns the new subtree root, NULL if out of memory
+*	(node is then still whole).
+*/
+static pbst_node_t *Balance(pbst_node_t *node)
+{
+	pbst_node_t *child = NULL, *pivot = NULL;
+	int side = 0;
+
+	UpdateHeight(node);
+	if (HEIGHT(node->child[0]) <= HEIGHT(node->child[1]) + 1 &&
+		HEIGHT(node->child[1]) <= HEIGHT(node->child[0]) + 1)
+	{
+		return node;
+	}
+
+	side = (HEIGHT(node->child[1]) > HEIGHT(node->child[0]));
+	child = node->child[side];
+	if (HEIGHT(child->child[!side]) > HEIGHT(child->child[side]))
+	{
+		child = Own(child);
+		if (!child)
+		{
+			return NULL;
+		}
+		node->child[side] = child;
+
+		pivot = RotateUp(child, !side);
+		if (!pivot)
+		{
+			return NULL;
+		}
+		node->child[side] = pivot;
+	}
+
+	return RotateUp(node, side);
+}
+
+/*
+*	rebuilds path->node[0 .. depth) above *subtree, copying each node with
+*	the new child on its side. the old path nodes stay in the old version.
+*	on success *subtree is the new root, on failure it has been released.
+*/
+static int CopyPath(path_t *path, pbst_node_t **subtree)
+{
+	pbst_node_t *old = NULL, *copy = NULL, *sibling = NULL;
+	int side = 0;
+
+	while (0 < path->depth)
+	{
+		--path->depth;
+		old = path->node[path->depth];
+		side = path->side[path->depth];
+		sibling = old->child[!side];
+
+		copy = CreateNode(old->data, NULL, NULL);
+		if (!copy)
+		{
+			Unref(*subtree);
+
+			return MALLOC_FAIL;
+		}
+
+		copy->child[side] = *subtree;
+		copy->child[!side] = sibling;
+		if (sibling)
+		{
+			INC_REF(sibling->ref_count);
+		}
+
+		*subtree = Balance(copy);
+		if (!*subtree)
+		{
+			Unref(copy);
+
+			return MALLOC_FAIL;
+		}
+	}
+
+	return SUCCESS;
+}
+
+/*
+*	return value - handle of a new version with data added (the caller
+*	holds it once), NULL on failure. the given version is not changed.
+*	arguments - version handle, void *data to insert.
+*	O(log n) new nodes.
+*/
+pbs_tree_t *PbstInsert(const pbs_tree_t *version, void *data)
+{
+	path_t path;
+	pbst_node_t *node = NULL, *root = NULL;
+	pbs_tree_t *new_version = NULL;
+
+	assert(version);
+	assert(data); /*cant compare NULL*/
+
+	path.depth = 0;
+	node = version->root;
+	while (node)
+	{
+		path.node[path.depth] = node;
+		path.side[path.depth] =
+				(version->cmp_func(data, node->data, version->param) > 0);
+		node = node->child[path.side[path.depth]];
+		++path.depth;
+	}
+
+	node = CreateNode(data, NULL, NULL);
+	if (!node)
+	{
+		return NULL;
+	}
+
+	root = node;
+	if (SUCCESS != CopyPath(&path, &root))
+	{
+		return NULL;
+	}
+
+	new_version = CreateVersion(version, root, version->num_of_elements + 1);
+	if (!new_version)
+	{
+		Unref(root);
+	}
+
+	return new_version;
+}
+
+/*
+*	points *replacement at the subtree that takes target's place: its
+*	children joined under the smallest node of its right subtree, which is
+*	removed from there.
+*/
+static int Unlink(pbst_node_t *target, pbst_node_t **replacement)
+{
+	path_t path;
+	pbst_node_t *node = NULL, *right = NULL, *joined = NULL;
+
+	if (!(target->child[0] && target->child[1]))
+	{
+		*replacement = target->child[NULL != target->child[1]];
+		if (*replacement)
+		{
+			INC_REF((*replacement)->ref_count);
+		}
+
+		return SUCCESS;
+	}
+
+	path.depth = 0;
+	node = target->child[1];
+	while (node->child[0])
+	{
+		path.node[path.depth] = node;
+		path.side[path.depth] = 0;
+		++path.depth;
+		node = node->child[0];
+	}
+
+	right = node->child[1];
+	if (right)
+	{
+		INC_REF(right->ref_count);
+	}
+
+	if (SUCCESS != CopyPath(&path, &right))
+	{
+		return MALLOC_FAIL;
+	}
+
+	joined = CreateNode(node->data, target->child[0], right);
+	if (!joined)
+	{
+		Unref(right);
+
+		return MALLOC_FAIL;
+	}
+	INC_REF(target->child[0]->ref_count);
+
+	*replacement = Balance(joined);
+	if (!*replacement)
+	{
+		Unref(joined);
+
+		return MALLOC_FAIL;
+	}
+
+	return SUCCESS;
+}
+
+/*
+*	return value - handle of a new version without one data equal to data
+*	(the caller holds it once), NULL on failure. if there is no such data
+*	the given version is acquired and returned. the given version is not
+*	changed.
+*	arguments - version handle, void *data to remove.
+*	O(log n) new nodes.
+*/
+pbs_tree_t *PbstRemove(pbs_tree_t *version, const void *data)
+{
+	path_t path;
+	pbst_node_t *node = NULL, *root = NULL;
+	pbs_tree_t *new_version = NULL;
+	int result = 0;
+
+	assert(version);
+
+	path.depth = 0;
+	node = version->root;
+	while (node)
+	{
+		result = version->cmp_func(data, node->data, version->param);
+		if (0 == result)
+		{
+			break;
+		}
+
+		path.node[path.depth] = node;
+		path.side[path.depth] = (result > 0);
+		node = node->child[result > 0];
+		++path.depth;
+	}
+
+	if (!node)
+	{
+		return PbstAcquire(version);
+	}
+
+	if (SUCCESS != Unlink(node, &root) || SUCCESS != CopyPath(&path, &root))
+	{
+		return NULL;
+	}
+
+	new_version = CreateVersion(version, root, version->num_of_elements - 1);
+	if (!new_version)
+	{
+		Unref(root);
+	}
+
+	return new_version;
+}
+
+/*
+*	return value - the data equal to data, NULL if there is none.
+*	arguments - version handle, void *data to find.
+*	O(log n), no locks and no writes.
+*/
+void *PbstFind(const pbs_tree_t *version, const void *data)
+{
+	pbst_node_t *node = NULL;
+	int result = 0;
+
+	assert(version);
+
+	node = version->root;
+	while (node)
+	{
+		result = version->cmp_func(data, node->data, version->param);
+		if (0 == result)
+		{
+			return node->data;
+		}
+
+		node = node->child[result > 0];
+	}
+
+	return NULL;
+}
+
+size_t PbstCount(const pbs_tree_t *version)
+{
+	assert(version);
+
+	return version->num_of_elements;
+}
+
+int PbstIsEmpty(const pbs_tree_t *version)
+{
+	assert(version);
+
+	return (NULL == version->root);
+}
+
+/*
+*	return value - 0 if every action succeeded, 1 if one failed.
+*	arguments - version handle, action function, param
+*	this function performs the given action for each element in order,
+*	stopping at the first failure.
+*/
+int PbstForEach(const pbs_tree_t *version, action_func_t act_func,
+																void *param)
+{
+	pbst_node_t *stack[MAX_HEIGHT];
+	pbst_node_t *node = NULL;
+	size_t depth = 0;
+
+	assert(version);
+	assert(act_func);
+
+	node = version->root;
+	while (node || 0 < depth)
+	{
+		for (; node; node = node->child[0])
+		{
+			stack[depth++] = node;
+		}
+
+		node = stack[--depth];
+		if (act_func(node->data, param))
+		{
+			return 1;
+		}
+		node = node->child[1];
+	}
+
+	return 0;
+}
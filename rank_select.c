@@ -0,0 +1,286 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "barr.h"
+#include "rank_select.h"
+
+/*
+* two level rank directory: an absolute count every 4096 bits and a 16-bit
+* count relative to it every 512 bits, about 4.7% on top of the bits.
+* select keeps the superblock of every 8192nd set bit, which bounds the
+* superblocks a search has to look at.
+*/
+#define WORDS_PER_BLOCK 8
+#define BLOCKS_PER_SUPER 8
+#define WORDS_PER_SUPER (WORDS_PER_BLOCK * BLOCKS_PER_SUPER)
+#define SELECT_SAMPLE 8192
+#define WORD_INDEX(index) ((index) / LENGTH)
+#define BIT_OFFSET(index) ((index) % LENGTH)
+#define DIV_ROUND_UP(a, b) (((a) + (b) - 1) / (b))
+#define LOW_BITS(width) ((1UL << (width)) - 1)
+
+struct rank_select_t
+{
+	const unsigned long *words;
+	size_t num_of_bits;
+	size_t num_of_words;
+	size_t num_of_blocks;
+	size_t count_on;
+	size_t *super_ranks; /*one extra entry holding count_on*/
+	unsigned short *block_ranks;
+	size_t *select_samples;
+};
+
+static size_t CountWords(const unsigned long *words, size_t num_of_words)
+{
+	size_t counter = 0;
+
+	while (num_of_words > 0)
+	{
+		--num_of_words;
+		counter += BitsArrayCountOn(words[num_of_words]);
+	}
+
+	return counter;
+}
+
+/*
+* returns the offset of the k-th (from 0) bit that is on in bit_array.
+* narrows the word by halves with popcount, then walks the last byte.
+*/
+static size_t SelectInWord(unsigned long bit_array, size_t k)
+{
+	size_t offset = 0;
+	size_t width = LENGTH / 2;
+	size_t counter = 0;
+
+	for (; width >= 8; width /= 2)
+	{
+		counter = BitsArrayCountOn(bit_array & LOW_BITS(width));
+		if (k >= counter)
+		{
+			k -= counter;
+			bit_array >>= width;
+			offset += width;
+		}
+	}
+
+	for (;; ++offset, bit_array >>= 1)
+	{
+		if (bit_array & 1)
+		{
+			if (0 == k)
+			{
+				return offset;
+			}
+
+			--k;
+		}
+	}
+}
+
+static void BuildDirectory(rank_select_t *rs)
+{
+	size_t super_rank = 0, block_rank = 0, block_count = 0;
+	size_t block = 0, next_sample = 0;
+	size_t words_in_block = 0;
+
+	for (block = 0; block < rs->num_of_blocks; ++block)
+	{
+		if (0 == block % BLOCKS_PER_SUPER)
+		{
+			super_rank += block_rank;
+			block_rank = 0;
+			rs->super_ranks[block / BLOCKS_PER_SUPER] = super_rank;
+		}
+
+		words_in_block = rs->num_of_words - block * WORDS_PER_BLOCK;
+		if (words_in_block > WORDS_PER_BLOCK)
+		{
+			words_in_block = WORDS_PER_BLOCK;
+		}
+
+		rs->block_ranks[block] = (unsigned short)block_rank;
+		block_count = CountWords(rs->words + block * WORDS_PER_BLOCK,
+															words_in_block);
+		block_rank += block_count;
+
+		/*every sample first reached in this block belongs to its superblock*/
+		while (next_sample * SELECT_SAMPLE < rs->count_on &&
+				next_sample * SELECT_SAMPLE < super_rank + block_rank)
+		{
+			rs->select_samples[next_sample] = block / BLOCKS_PER_SUPER;
+			++next_sample;
+		}
+	}
+
+	rs->super_ranks[DIV_ROUND_UP(rs->num_of_blocks, BLOCKS_PER_SUPER)] =
+																rs->count_on;
+}
+
+/*
+* receives a bit array buffer and the number of bits in it. the bits past
+* num_of_bits in the last word must be 0 (a bitset_t buffer always is).
+* builds a rank/select directory over the buffer. the buffer is not copied,
+* so it must stay alive and unchanged while the directory is in use.
+* returns the directory if succeeded, NULL otherwise.
+* O(n).
+*/
+rank_select_t *RankSelectCreate(const unsigned long *words, size_t num_of_bits)
+{
+	rank_select_t *rs = NULL;
+	size_t num_of_words = 0, num_of_blocks = 0, num_of_supers = 0;
+	size_t count_on = 0, num_of_samples = 0;
+
+	assert(NULL != words);
+	assert(0 < num_of_bits);
+
+	num_of_words = DIV_ROUND_UP(num_of_bits, LENGTH);
+	num_of_blocks = DIV_ROUND_UP(num_of_words, WORDS_PER_BLOCK);
+	num_of_supers = DIV_ROUND_UP(num_of_blocks, BLOCKS_PER_SUPER);
+	count_on = BitsArrayCountOnBuffer(words, num_of_words);
+	num_of_samples = DIV_ROUND_UP(count_on, SELECT_SAMPLE);
+
+	rs = malloc(sizeof(rank_select_t) +
+				(num_of_supers + 1 + num_of_samples) * sizeof(size_t) +
+				num_of_blocks * sizeof(unsigned short));
+	if (NULL == rs)
+	{
+		return NULL;
+	}
+
+	rs->words = words;
+	rs->num_of_bits = num_of_bits;
+	rs->num_of_words = num_of_words;
+	rs->num_of_blocks = num_of_blocks;
+	rs->count_on = count_on;
+	rs->super_ranks = (size_t *)((char *)rs + sizeof(rank_select_t));
+	rs->select_samples = rs->super_ranks + num_of_supers + 1;
+	rs->block_ranks = (unsigned short *)(rs->select_samples + num_of_samples);
+
+	BuildDirectory(rs);
+
+	return rs;
+}
+
+/*
+* receives a rank/select directory and frees it (not the bits).
+* O(1).
+*/
+void RankSelectDestroy(rank_select_t *rs)
+{
+	assert(rs);
+
+	free(rs);
+}
+
+/*
+* receives a rank/select directory.
+* returns the number of bits that are on.
+* O(1).
+*/
+size_t RankSelectCountOn(const rank_select_t *rs)
+{
+	assert(rs);
+
+	return rs->count_on;
+}
+
+/*
+* receives a rank/select directory and a bit index (up to the bit count).
+* returns how many bits are on before the index.
+* O(1): two table reads and at most 8 popcounts.
+*/
+size_t RankSelectRank(const rank_select_t *rs, size_t index)
+{
+	size_t word = 0, block = 0;
+	size_t rank = 0;
+
+	assert(rs);
+	assert(index <= rs->num_of_bits);
+
+	if (index == rs->num_of_bits)
+	{
+		return rs->count_on;
+	}
+
+	word = WORD_INDEX(index);
+	block = word / WORDS_PER_BLOCK;
+
+	rank = rs->super_ranks[block / BLOCKS_PER_SUPER] + rs->block_ranks[block];
+	rank += CountWords(rs->words + block * WORDS_PER_BLOCK,
+										word - block * WORDS_PER_BLOCK);
+	rank += BitsArrayCountOn(rs->words[word] & LOW_BITS(BIT_OFFSET(index)));
+
+	return rank;
+}
+
+/*
+* receives a rank/select directory and k.
+* returns the index of the k-th (counting from 0) bit that is on, or the bit
+* count if fewer than k + 1 bits are on.
+* O(log s) for the s superblocks between the two samples around k, then 8
+* blocks and 8 words. s is 1 or 2 on dense bitmaps but reaches thousands
+* on sparse ones (one set bit per superblock gives 8192), hence the binary
+* search rather than a scan.
+*/
+size_t RankSelectSelect(const rank_select_t *rs, size_t k)
+{
+	size_t sample = 0, super = 0, last_super = 0, middle = 0;
+	size_t block = 0, last_block = 0, word = 0;
+	size_t counter = 0;
+
+	assert(rs);
+
+	if (k >= rs->count_on)
+	{
+		return rs->num_of_bits;
+	}
+
+	/*the first superblock whose end passes k, between the two samples*/
+	sample = k / SELECT_SAMPLE;
+	super = rs->select_samples[sample];
+	last_super = DIV_ROUND_UP(rs->num_of_blocks, BLOCKS_PER_SUPER) - 1;
+	if (sample + 1 < DIV_ROUND_UP(rs->count_on, SELECT_SAMPLE))
+	{
+		last_super = rs->select_samples[sample + 1];
+	}
+
+	while (super < last_super)
+	{
+		middle = super + (last_super - super) / 2;
+		if (rs->super_ranks[middle + 1] <= k)
+		{
+			super = middle + 1;
+		}
+		else
+		{
+			last_super = middle;
+		}
+	}
+	k -= rs->super_ranks[super];
+
+	block = super * BLOCKS_PER_SUPER;
+	last_block = block + BLOCKS_PER_SUPER;
+	if (last_block > rs->num_of_blocks)
+	{
+		last_block = rs->num_of_blocks;
+	}
+
+	while (block + 1 < last_block && rs->block_ranks[block + 1] <= k)
+	{
+		++block;
+	}
+	k -= rs->block_ranks[block];
+
+	word = block * WORDS_PER_BLOCK;
+	counter = BitsArrayCountOn(rs->words[word]);
+	while (counter <= k)
+	{
+		k -= counter;
+		++word;
+		counter = BitsArrayCountOn(rs->words[word]);
+	}
+
+	return (word * LENGTH + SelectInWord(rs->words[word], k));
+}
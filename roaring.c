@@ -0,0 +1,1580 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "barr.h"
+#include "bitset.h"
+#include "roaring.h"
+
+/*
+* the 32-bit space is split into 2^16 chunks by the high 16 bits. each
+* non-empty chunk is a container holding the low 16 bits as a sorted array
+* (up to ARRAY_MAX values), a 2^16 bit bitset, or a sorted list of runs.
+* mutations work on arrays and bitmaps. runs come from RoaringOptimize and
+* from set operations, which shrink every result to its smallest layout.
+*/
+#define CHUNK_BITS 16
+#define CHUNK_SIZE (1UL << CHUNK_BITS)
+#define ARRAY_MAX 4096
+#define BITMAP_WORDS (CHUNK_SIZE / LENGTH)
+#define HIGH(value) ((unsigned short)((value) >> CHUNK_BITS))
+#define LOW(value) ((unsigned short)((value) & (CHUNK_SIZE - 1)))
+#define ARRAY(c) ((unsigned short *)(c)->data)
+#define RUNS(c) ((run_t *)(c)->data)
+#define BITMAP(c) ((bitset_t *)(c)->data)
+#define WORDS(c) BitSetData(BITMAP(c))
+#define RUN_END(run) ((size_t)(run).start + (run).length)
+#define ARRAY_BYTES(cardinality) ((cardinality) * sizeof(unsigned short))
+#define RUN_BYTES(num_of_runs) ((num_of_runs) * sizeof(run_t))
+#define BITMAP_BYTES (BITMAP_WORDS * sizeof(unsigned long))
+#define MIN(a,b) (((a)<(b))? (a):(b))
+#define MAX(a,b) (((a)>(b))? (a):(b))
+
+enum return_status
+{
+	SUCCESS,
+	MALLOC_FAIL
+};
+
+enum container_type
+{
+	ARRAY_CONTAINER,
+	BITMAP_CONTAINER,
+	RUN_CONTAINER
+};
+
+typedef struct run_t
+{
+	unsigned short start;
+	unsigned short length; /*number of values - 1*/
+} run_t;
+
+typedef struct container_t
+{
+	unsigned short key;
+	unsigned short type;
+	size_t cardinality;
+	size_t size; /*values in an array, runs in a run list*/
+	size_t capacity;
+	void *data;
+} container_t;
+
+struct roaring_t
+{
+	size_t num_of_containers;
+	size_t capacity;
+	container_t *containers;
+};
+
+typedef struct serial_header_t
+{
+	unsigned short key;
+	unsigned short type;
+	unsigned int cardinality;
+	unsigned int size;
+} serial_header_t;
+
+/****************************** bitmap helpers ******************************/
+
+static unsigned long RangeMask(size_t word, size_t start, size_t end)
+{
+	size_t low = MAX(start, word * LENGTH) - word * LENGTH;
+	size_t high = MIN(end, word * LENGTH + LENGTH - 1) - word * LENGTH;
+	unsigned long mask = ~0UL << low;
+
+	if (high < LENGTH - 1)
+	{
+		mask &= (1UL << (high + 1)) - 1;
+	}
+
+	return mask;
+}
+
+static void SetRange(unsigned long *words, size_t start, size_t end)
+{
+	size_t word = 0;
+
+	for (word = start / LENGTH; word <= end / LENGTH; ++word)
+	{
+		words[word] |= RangeMask(word, start, end);
+	}
+}
+
+/**************************** container helpers *****************************/
+
+static int InitArray(container_t *c, unsigned short key, size_t capacity)
+{
+	c->data = malloc(ARRAY_BYTES(capacity));
+	if (NULL == c->data)
+	{
+		return MALLOC_FAIL;
+	}
+
+	c->key = key;
+	c->type = ARRAY_CONTAINER;
+	c->cardinality = 0;
+	c->size = 0;
+	c->capacity = capacity;
+
+	return SUCCESS;
+}
+
+static int InitBitmap(container_t *c, unsigned short key)
+{
+	c->data = BitSetCreate(CHUNK_SIZE);
+	if (NULL == c->data)
+	{
+		return MALLOC_FAIL;
+	}
+
+	c->key = key;
+	c->type = BITMAP_CONTAINER;
+	c->cardinality = 0;
+	c->size = 0;
+	c->capacity = 0;
+
+	return SUCCESS;
+}
+
+static int InitRuns(container_t *c, unsigned short key, size_t capacity)
+{
+	c->data = malloc(RUN_BYTES(MAX(capacity, 1)));
+	if (NULL == c->data)
+	{
+		return MALLOC_FAIL;
+	}
+
+	c->key = key;
+	c->type = RUN_CONTAINER;
+	c->cardinality = 0;
+	c->size = 0;
+	c->capacity = MAX(capacity, 1);
+
+	return SUCCESS;
+}
+
+static void FreeContainer(container_t *c)
+{
+	if (BITMAP_CONTAINER == c->type)
+	{
+		BitSetDestroy(BITMAP(c));
+	}
+	else
+	{
+		free(c->data);
+	}
+
+	c->data = NULL;
+}
+
+static void ReplaceContainer(container_t *c, container_t *replacement)
+{
+	FreeContainer(c);
+	*c = *replacement;
+}
+
+/* appends a run, merging it into the last one when they touch */
+static void AppendRun(container_t *c, size_t start, size_t end)
+{
+	run_t *last = NULL;
+
+	if (0 < c->size)
+	{
+		last = &RUNS(c)[c->size - 1];
+		if (start <= RUN_END(*last) + 1)
+		{
+			if (end > RUN_END(*last))
+			{
+				c->cardinality += end - RUN_END(*last);
+				last->length = (unsigned short)(end - last->start);
+			}
+
+			return;
+		}
+	}
+
+	assert(c->size < c->capacity);
+
+	RUNS(c)[c->size].start = (unsigned short)start;
+	RUNS(c)[c->size].length = (unsigned short)(end - start);
+	c->cardinality += end - start + 1;
+	++c->size;
+}
+
+static size_t CountRuns(const container_t *c)
+{
+	size_t counter = 0, i = 0;
+	unsigned long carry = 0, word = 0;
+
+	switch (c->type)
+	{
+		case ARRAY_CONTAINER:
+			for (i = 0; i < c->size; ++i)
+			{
+				counter += (0 == i || ARRAY(c)[i - 1] + 1 != ARRAY(c)[i]);
+			}
+			break;
+
+		case BITMAP_CONTAINER:
+			for (i = 0; i < BITMAP_WORDS; ++i)
+			{
+				word = WORDS(c)[i];
+				counter += BitsArrayCountOn(word & ~((word << 1) | carry));
+				carry = word >> (LENGTH - 1);
+			}
+			break;
+
+		default:
+			counter = c->size;
+	}
+
+	return counter;
+}
+
+static int ToArray(container_t *c)
+{
+	container_t array = {0};
+	unsigned long word = 0;
+	size_t i = 0, value = 0;
+
+	assert(c->cardinality <= ARRAY_MAX);
+
+	if (MALLOC_FAIL == InitArray(&array, c->key, MAX(c->cardinality, 1)))
+	{
+		return MALLOC_FAIL;
+	}
+
+	if (BITMAP_CONTAINER == c->type)
+	{
+		for (i = 0; i < BITMAP_WORDS; ++i)
+		{
+			for (word = WORDS(c)[i]; word; word &= word - 1)
+			{
+				ARRAY(&array)[array.size++] = (unsigned short)(i * LENGTH +
+												BitsArrayFindFirstOn(word));
+			}
+		}
+	}
+	else
+	{
+		for (i = 0; i < c->size; ++i)
+		{
+			for (value = RUNS(c)[i].start; value <= RUN_END(RUNS(c)[i]);
+																	++value)
+			{
+				ARRAY(&array)[array.size++] = (unsigned short)value;
+			}
+		}
+	}
+
+	array.cardinality = array.size;
+	ReplaceContainer(c, &array);
+
+	return SUCCESS;
+}
+
+static int ToBitmap(container_t *c)
+{
+	container_t bitmap = {0};
+	size_t i = 0;
+
+	if (MALLOC_FAIL == InitBitmap(&bitmap, c->key))
+	{
+		return MALLOC_FAIL;
+	}
+
+	if (ARRAY_CONTAINER == c->type)
+	{
+		for (i = 0; i < c->size; ++i)
+		{
+			BitSetSetOn(BITMAP(&bitmap), ARRAY(c)[i]);
+		}
+	}
+	else
+	{
+		for (i = 0; i < c->size; ++i)
+		{
+			SetRange(WORDS(&bitmap), RUNS(c)[i].start, RUN_END(RUNS(c)[i]));
+		}
+	}
+
+	bitmap.cardinality = c->cardinality;
+	ReplaceContainer(c, &bitmap);
+
+	return SUCCESS;
+}
+
+static int ToRuns(container_t *c, size_t num_of_runs)
+{
+	container_t runs = {0};
+	unsigned long word = 0;
+	size_t i = 0, bit = 0;
+
+	if (MALLOC_FAIL == InitRuns(&runs, c->key, num_of_runs))
+	{
+		return MALLOC_FAIL;
+	}
+
+	if (ARRAY_CONTAINER == c->type)
+	{
+		for (i = 0; i < c->size; ++i)
+		{
+			AppendRun(&runs, ARRAY(c)[i], ARRAY(c)[i]);
+		}
+	}
+	else
+	{
+		for (i = 0; i < BITMAP_WORDS; ++i)
+		{
+			for (word = WORDS(c)[i]; word; word &= word - 1)
+			{
+				bit = i * LENGTH + BitsArrayFindFirstOn(word);
+				AppendRun(&runs, bit, bit);
+			}
+		}
+	}
+
+	ReplaceContainer(c, &runs);
+
+	return SUCCESS;
+}
+
+/* turns a run list back into an array or a bitmap so it can be mutated */
+static int ExpandRuns(container_t *c)
+{
+	if (c->cardinality <= ARRAY_MAX)
+	{
+		return ToArray(c);
+	}
+
+	return ToBitmap(c);
+}
+
+/* converts a container to whichever of the three layouts is smallest */
+static int Shrink(container_t *c)
+{
+	size_t num_of_runs = CountRuns(c);
+	size_t run_bytes = RUN_BYTES(num_of_runs);
+	size_t array_bytes = ARRAY_BYTES(c->cardinality);
+
+	if (run_bytes < MIN(array_bytes, BITMAP_BYTES))
+	{
+		return (RUN_CONTAINER == c->type) ? SUCCESS : ToRuns(c, num_of_runs);
+	}
+
+	if (c->cardinality <= ARRAY_MAX)
+	{
+		return (ARRAY_CONTAINER == c->type) ? SUCCESS : ToArray(c);
+	}
+
+	return (BITMAP_CONTAINER == c->type) ? SUCCESS : ToBitmap(c);
+}
+
+static size_t ArrayFind(const container_t *c, unsigned short low)
+{
+	size_t from = 0, to = c->size, middle = 0;
+
+	while (from < to)
+	{
+		middle = from + (to - from) / 2;
+		if (ARRAY(c)[middle] < low)
+		{
+			from = middle + 1;
+		}
+		else
+		{
+			to = middle;
+		}
+	}
+
+	return from;
+}
+
+static int RunsContain(const container_t *c, unsigned short low)
+{
+	size_t from = 0, to = c->size, middle = 0;
+
+	/* find the last run starting at or before low */
+	while (from < to)
+	{
+		middle = from + (to - from) / 2;
+		if (RUNS(c)[middle].start <= low)
+		{
+			from = middle + 1;
+		}
+		else
+		{
+			to = middle;
+		}
+	}
+
+	return (0 < from && low <= RUN_END(RUNS(c)[from - 1]));
+}
+
+static int ContainerContains(const container_t *c, unsigned short low)
+{
+	size_t index = 0;
+
+	switch (c->type)
+	{
+		case ARRAY_CONTAINER:
+			index = ArrayFind(c, low);
+			return (index < c->size && ARRAY(c)[index] == low);
+
+		case BITMAP_CONTAINER:
+			return BitSetIsOn(BITMAP(c), low);
+
+		default:
+			return RunsContain(c, low);
+	}
+}
+
+static size_t PayloadBytes(const container_t *c)
+{
+	switch (c->type)
+	{
+		case ARRAY_CONTAINER:
+			return ARRAY_BYTES(c->size);
+
+		case BITMAP_CONTAINER:
+			return BITMAP_BYTES;
+
+		default:
+			return RUN_BYTES(c->size);
+	}
+}
+
+static const void *PayloadOf(const container_t *c)
+{
+	return (BITMAP_CONTAINER == c->type) ?
+						(const void *)WORDS(c) : (const void *)c->data;
+}
+
+/***************************** container list ******************************/
+
+static size_t FindKey(const roaring_t *roaring, unsigned short key)
+{
+	size_t from = 0, to = roaring->num_of_containers, middle = 0;
+
+	while (from < to)
+	{
+		middle = from + (to - from) / 2;
+		if (roaring->containers[middle].key < key)
+		{
+			from = middle + 1;
+		}
+		else
+		{
+			to = middle;
+		}
+	}
+
+	return from;
+}
+
+static int Reserve(roaring_t *roaring, size_t capacity)
+{
+	container_t *containers = NULL;
+
+	if (capacity <= roaring->capacity)
+	{
+		return SUCCESS;
+	}
+
+	capacity = MAX(capacity, 2 * roaring->capacity);
+	containers = realloc(roaring->containers, capacity * sizeof(container_t));
+	if (NULL == containers)
+	{
+		return MALLOC_FAIL;
+	}
+
+	roaring->containers = containers;
+	roaring->capacity = capacity;
+
+	return SUCCESS;
+}
+
+static int InsertContainer(roaring_t *roaring, size_t index, container_t *c)
+{
+	if (MALLOC_FAIL == Reserve(roaring, roaring->num_of_containers + 1))
+	{
+		return MALLOC_FAIL;
+	}
+
+	memmove(roaring->containers + index + 1, roaring->containers + index,
+			(roaring->num_of_containers - index) * sizeof(container_t));
+	roaring->containers[index] = *c;
+	++roaring->num_of_containers;
+
+	return SUCCESS;
+}
+
+static void RemoveContainer(roaring_t *roaring, size_t index)
+{
+	FreeContainer(&roaring->containers[index]);
+	--roaring->num_of_containers;
+	memmove(roaring->containers + index, roaring->containers + index + 1,
+			(roaring->num_of_containers - index) * sizeof(container_t));
+}
+
+/* takes ownership of c: appends it, or frees it if it came out empty */
+static int AppendContainer(roaring_t *roaring, container_t *c)
+{
+	if (0 == c->cardinality)
+	{
+		FreeContainer(c);
+
+		return SUCCESS;
+	}
+
+	if (MALLOC_FAIL == Shrink(c) ||
+		MALLOC_FAIL == InsertContainer(roaring, roaring->num_of_containers, c))
+	{
+		FreeContainer(c);
+
+		return MALLOC_FAIL;
+	}
+
+	return SUCCESS;
+}
+
+/*
+* receives nothing.
+* creates an empty compressed bitmap.
+* returns the bitmap if succeeded, NULL otherwise.
+* O(1).
+*/
+roaring_t *RoaringCreate(void)
+{
+	roaring_t *roaring = malloc(sizeof(roaring_t));
+	if (NULL == roaring)
+	{
+		return NULL;
+	}
+
+	roaring->num_of_containers = 0;
+	roaring->capacity = 0;
+	roaring->containers = NULL;
+
+	return roaring;
+}
+
+/*
+* receives a compressed bitmap and frees it.
+* O(number of containers).
+*/
+void RoaringDestroy(roaring_t *roaring)
+{
+	size_t i = 0;
+
+	assert(roaring);
+
+	for (i = 0; i < roaring->num_of_containers; ++i)
+	{
+		FreeContainer(&roaring->containers[i]);
+	}
+
+	free(roaring->containers);
+	free(roaring);
+}
+
+/*
+* receives a compressed bitmap and a value.
+* adds the value to the set (adding an existing value is a no-op).
+* returns status.
+* O(log containers + ARRAY_MAX) worst case, O(log containers) for bitmaps.
+*/
+int RoaringAdd(roaring_t *roaring, unsigned int value)
+{
+	container_t new_container = {0};
+	container_t *c = NULL;
+	size_t index = 0;
+
+	assert(roaring);
+
+	index = FindKey(roaring, HIGH(value));
+	if (index == roaring->num_of_containers ||
+		roaring->containers[index].key != HIGH(value))
+	{
+		if (MALLOC_FAIL == InitArray(&new_container, HIGH(value), 4) ||
+			MALLOC_FAIL == InsertContainer(roaring, index, &new_container))
+		{
+			free(new_container.data);
+
+			return MALLOC_FAIL;
+		}
+	}
+
+	c = &roaring->containers[index];
+	if (RUN_CONTAINER == c->type)
+	{
+		if (RunsContain(c, LOW(value)))
+		{
+			return SUCCESS;
+		}
+
+		if (MALLOC_FAIL == ExpandRuns(c))
+		{
+			return MALLOC_FAIL;
+		}
+	}
+
+	if (ARRAY_CONTAINER == c->type)
+	{
+		index = ArrayFind(c, LOW(value));
+		if (index < c->size && ARRAY(c)[index] == LOW(value))
+		{
+			return SUCCESS;
+		}
+
+		if (ARRAY_MAX == c->cardinality)
+		{
+			if (MALLOC_FAIL == ToBitmap(c))
+			{
+				return MALLOC_FAIL;
+			}
+		}
+		else
+		{
+			if (c->size == c->capacity)
+			{
+				new_container.data = realloc(c->data,
+											ARRAY_BYTES(2 * c->capacity));
+				if (NULL == new_container.data)
+				{
+					return MALLOC_FAIL;
+				}
+
+				c->data = new_container.data;
+				c->capacity *= 2;
+			}
+
+			memmove(ARRAY(c) + index + 1, ARRAY(c) + index,
+										ARRAY_BYTES(c->size - index));
+			ARRAY(c)[index] = LOW(value);
+			++c->size;
+			++c->cardinality;
+
+			return SUCCESS;
+		}
+	}
+
+	if (BitSetIsOff(BITMAP(c), LOW(value)))
+	{
+		BitSetSetOn(BITMAP(c), LOW(value));
+		++c->cardinality;
+	}
+
+	return SUCCESS;
+}
+
+/*
+* receives a compressed bitmap and a value.
+* removes the value from the set (removing a missing value is a no-op).
+* returns status.
+* O(log containers + ARRAY_MAX) worst case.
+*/
+int RoaringRemove(roaring_t *roaring, unsigned int value)
+{
+	container_t *c = NULL;
+	size_t index = 0, container_index = 0;
+
+	assert(roaring);
+
+	container_index = FindKey(roaring, HIGH(value));
+	if (container_index == roaring->num_of_containers ||
+		roaring->containers[container_index].key != HIGH(value))
+	{
+		return SUCCESS;
+	}
+
+	c = &roaring->containers[container_index];
+	if (!ContainerContains(c, LOW(value)))
+	{
+		return SUCCESS;
+	}
+
+	if (RUN_CONTAINER == c->type && MALLOC_FAIL == ExpandRuns(c))
+	{
+		return MALLOC_FAIL;
+	}
+
+	if (ARRAY_CONTAINER == c->type)
+	{
+		index = ArrayFind(c, LOW(value));
+		memmove(ARRAY(c) + index, ARRAY(c) + index + 1,
+										ARRAY_BYTES(c->size - index - 1));
+		--c->size;
+	}
+	else
+	{
+		BitSetSetOff(BITMAP(c), LOW(value));
+	}
+
+	--c->cardinality;
+	if (0 == c->cardinality)
+	{
+		RemoveContainer(roaring, container_index);
+	}
+	else if (BITMAP_CONTAINER == c->type && c->cardinality <= ARRAY_MAX)
+	{
+		/*
+		* the value is already gone and the bitmap is still valid, so a failed
+		* conversion is not an error. the next removal tries again.
+		*/
+		ToArray(c);
+	}
+
+	return SUCCESS;
+}
+
+/*
+* receives a compressed bitmap and a value.
+* returns 1 if the value is in the set, 0 otherwise.
+* O(log containers + log ARRAY_MAX).
+*/
+int RoaringContains(const roaring_t *roaring, unsigned int value)
+{
+	size_t index = 0;
+
+	assert(roaring);
+
+	index = FindKey(roaring, HIGH(value));
+
+	return (index < roaring->num_of_containers &&
+			roaring->containers[index].key == HIGH(value) &&
+			ContainerContains(&roaring->containers[index], LOW(value)));
+}
+
+/*
+* receives a compressed bitmap.
+* returns the number of values in the set.
+* O(number of containers).
+*/
+size_t RoaringCardinality(const roaring_t *roaring)
+{
+	size_t counter = 0, i = 0;
+
+	assert(roaring);
+
+	for (i = 0; i < roaring->num_of_containers; ++i)
+	{
+		counter += roaring->containers[i].cardinality;
+	}
+
+	return counter;
+}
+
+/*
+* receives a compressed bitmap.
+* returns the number of bytes it uses, containers included.
+* O(number of containers).
+*/
+size_t RoaringMemoryConsumption(const roaring_t *roaring)
+{
+	size_t bytes = 0, i = 0;
+	const container_t *c = NULL;
+
+	assert(roaring);
+
+	bytes = sizeof(roaring_t) + roaring->capacity * sizeof(container_t);
+	for (i = 0; i < roaring->num_of_containers; ++i)
+	{
+		c = &roaring->containers[i];
+		switch (c->type)
+		{
+			case ARRAY_CONTAINER:
+				bytes += ARRAY_BYTES(c->capacity);
+				break;
+
+			case BITMAP_CONTAINER:
+				bytes += BITMAP_BYTES;
+				break;
+
+			default:
+				bytes += RUN_BYTES(c->capacity);
+		}
+	}
+
+	return bytes;
+}
+
+/*
+* receives a compressed bitmap.
+* converts every container to its smallest layout, turning clustered values
+* into run lists.
+* returns status.
+* O(n).
+*/
+int RoaringOptimize(roaring_t *roaring)
+{
+	size_t i = 0;
+
+	assert(roaring);
+
+	for (i = 0; i < roaring->num_of_containers; ++i)
+	{
+		if (MALLOC_FAIL == Shrink(&roaring->containers[i]))
+		{
+			return MALLOC_FAIL;
+		}
+	}
+
+	return SUCCESS;
+}
+
+/*
+* receives a compressed bitmap, an action function and a param.
+* calls the action on every value in ascending order, stopping at the first
+* non-zero result.
+* returns the last action result.
+* O(n).
+*/
+int RoaringForEach(const roaring_t *roaring, roaring_act_func_t action,
+																void *param)
+{
+	const container_t *c = NULL;
+	unsigned int base = 0;
+	unsigned long word = 0;
+	size_t i = 0, j = 0, value = 0;
+	int res = 0;
+
+	assert(roaring);
+	assert(action);
+
+	for (i = 0; i < roaring->num_of_containers && 0 == res; ++i)
+	{
+		c = &roaring->containers[i];
+		base = (unsigned int)c->key << CHUNK_BITS;
+
+		switch (c->type)
+		{
+			case ARRAY_CONTAINER:
+				for (j = 0; j < c->size && 0 == res; ++j)
+				{
+					res = action(base | ARRAY(c)[j], param);
+				}
+				break;
+
+			case BITMAP_CONTAINER:
+				for (j = 0; j < BITMAP_WORDS && 0 == res; ++j)
+				{
+					for (word = WORDS(c)[j]; word && 0 == res;
+														word &= word - 1)
+					{
+						res = action(base | (unsigned int)(j * LENGTH +
+									BitsArrayFindFirstOn(word)), param);
+					}
+				}
+				break;
+
+			default:
+				for (j = 0; j < c->size && 0 == res; ++j)
+				{
+					for (value = RUNS(c)[j].start;
+						value <= RUN_END(RUNS(c)[j]) && 0 == res; ++value)
+					{
+						res = action(base | (unsigned int)value, param);
+					}
+				}
+		}
+	}
+
+	return res;
+}
+
+/************************* intersection per pair ****************************/
+
+static int AndArrayArray(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	size_t i = 0, j = 0;
+
+	if (MALLOC_FAIL == InitArray(out, a->key, MIN(a->size, b->size) + 1))
+	{
+		return MALLOC_FAIL;
+	}
+
+	while (i < a->size && j < b->size)
+	{
+		if (ARRAY(a)[i] < ARRAY(b)[j])
+		{
+			++i;
+		}
+		else if (ARRAY(b)[j] < ARRAY(a)[i])
+		{
+			++j;
+		}
+		else
+		{
+			ARRAY(out)[out->size++] = ARRAY(a)[i];
+			++i;
+			++j;
+		}
+	}
+
+	out->cardinality = out->size;
+
+	return SUCCESS;
+}
+
+static int AndArrayBitmap(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	size_t i = 0;
+
+	if (MALLOC_FAIL == InitArray(out, a->key, a->size))
+	{
+		return MALLOC_FAIL;
+	}
+
+	for (i = 0; i < a->size; ++i)
+	{
+		ARRAY(out)[out->size] = ARRAY(a)[i];
+		out->size += BitSetIsOn(BITMAP(b), ARRAY(a)[i]);
+	}
+
+	out->cardinality = out->size;
+
+	return SUCCESS;
+}
+
+static int AndArrayRuns(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	size_t i = 0, j = 0;
+
+	if (MALLOC_FAIL == InitArray(out, a->key, a->size))
+	{
+		return MALLOC_FAIL;
+	}
+
+	while (i < a->size && j < b->size)
+	{
+		if (ARRAY(a)[i] < RUNS(b)[j].start)
+		{
+			++i;
+		}
+		else if (ARRAY(a)[i] > RUN_END(RUNS(b)[j]))
+		{
+			++j;
+		}
+		else
+		{
+			ARRAY(out)[out->size++] = ARRAY(a)[i];
+			++i;
+		}
+	}
+
+	out->cardinality = out->size;
+
+	return SUCCESS;
+}
+
+static int AndBitmapBitmap(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	if (MALLOC_FAIL == InitBitmap(out, a->key))
+	{
+		return MALLOC_FAIL;
+	}
+
+	BitSetAnd(BITMAP(out), BITMAP(a), BITMAP(b));
+	out->cardinality = BitSetCountOn(BITMAP(out));
+
+	return SUCCESS;
+}
+
+static int AndBitmapRuns(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	size_t i = 0, word = 0;
+	run_t run = {0};
+
+	if (MALLOC_FAIL == InitBitmap(out, a->key))
+	{
+		return MALLOC_FAIL;
+	}
+
+	for (i = 0; i < b->size; ++i)
+	{
+		run = RUNS(b)[i];
+		for (word = run.start / LENGTH; word <= RUN_END(run) / LENGTH; ++word)
+		{
+			WORDS(out)[word] |= WORDS(a)[word] &
+								RangeMask(word, run.start, RUN_END(run));
+		}
+	}
+
+	out->cardinality = BitSetCountOn(BITMAP(out));
+
+	return SUCCESS;
+}
+
+static int AndRunsRuns(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	size_t i = 0, j = 0;
+	size_t start = 0, end = 0;
+
+	if (MALLOC_FAIL == InitRuns(out, a->key, a->size + b->size))
+	{
+		return MALLOC_FAIL;
+	}
+
+	while (i < a->size && j < b->size)
+	{
+		start = MAX(RUNS(a)[i].start, RUNS(b)[j].start);
+		end = MIN(RUN_END(RUNS(a)[i]), RUN_END(RUNS(b)[j]));
+		if (start <= end)
+		{
+			AppendRun(out, start, end);
+		}
+
+		if (RUN_END(RUNS(a)[i]) < RUN_END(RUNS(b)[j]))
+		{
+			++i;
+		}
+		else
+		{
+			++j;
+		}
+	}
+
+	return SUCCESS;
+}
+
+/*************************** union per pair *********************************/
+
+static int OrArrayArray(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	size_t i = 0, j = 0;
+
+	if (MALLOC_FAIL == InitArray(out, a->key, a->size + b->size))
+	{
+		return MALLOC_FAIL;
+	}
+
+	while (i < a->size || j < b->size)
+	{
+		if (j == b->size || (i < a->size && ARRAY(a)[i] < ARRAY(b)[j]))
+		{
+			ARRAY(out)[out->size++] = ARRAY(a)[i++];
+		}
+		else if (i == a->size || ARRAY(b)[j] < ARRAY(a)[i])
+		{
+			ARRAY(out)[out->size++] = ARRAY(b)[j++];
+		}
+		else
+		{
+			ARRAY(out)[out->size++] = ARRAY(a)[i++];
+			++j;
+		}
+	}
+
+	out->cardinality = out->size;
+
+	return SUCCESS;
+}
+
+static int OrArrayBitmap(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	size_t i = 0;
+
+	if (MALLOC_FAIL == InitBitmap(out, a->key))
+	{
+		return MALLOC_FAIL;
+	}
+
+	BitSetOr(BITMAP(out), BITMAP(b), BITMAP(out));
+	out->cardinality = b->cardinality;
+	for (i = 0; i < a->size; ++i)
+	{
+		out->cardinality += BitSetIsOff(BITMAP(out), ARRAY(a)[i]);
+		BitSetSetOn(BITMAP(out), ARRAY(a)[i]);
+	}
+
+	return SUCCESS;
+}
+
+static int OrBitmapBitmap(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	if (MALLOC_FAIL == InitBitmap(out, a->key))
+	{
+		return MALLOC_FAIL;
+	}
+
+	BitSetOr(BITMAP(out), BITMAP(a), BITMAP(b));
+	out->cardinality = BitSetCountOn(BITMAP(out));
+
+	return SUCCESS;
+}
+
+static int OrBitmapRuns(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	size_t i = 0;
+
+	if (MALLOC_FAIL == InitBitmap(out, a->key))
+	{
+		return MALLOC_FAIL;
+	}
+
+	BitSetOr(BITMAP(out), BITMAP(a), BITMAP(out));
+	for (i = 0; i < b->size; ++i)
+	{
+		SetRange(WORDS(out), RUNS(b)[i].start, RUN_END(RUNS(b)[i]));
+	}
+
+	out->cardinality = BitSetCountOn(BITMAP(out));
+
+	return SUCCESS;
+}
+
+/* array values take part in the merge as runs of length 1 */
+static int OrRunsRunsOrArray(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	size_t i = 0, j = 0;
+	size_t a_start = 0, a_end = 0;
+
+	if (MALLOC_FAIL == InitRuns(out, a->key, a->size + b->size))
+	{
+		return MALLOC_FAIL;
+	}
+
+	while (i < a->size || j < b->size)
+	{
+		if (i < a->size)
+		{
+			a_start = (ARRAY_CONTAINER == a->type) ?
+									ARRAY(a)[i] : RUNS(a)[i].start;
+			a_end = (ARRAY_CONTAINER == a->type) ?
+									ARRAY(a)[i] : RUN_END(RUNS(a)[i]);
+		}
+
+		if (j == b->size || (i < a->size && a_start < RUNS(b)[j].start))
+		{
+			AppendRun(out, a_start, a_end);
+			++i;
+		}
+		else
+		{
+			AppendRun(out, RUNS(b)[j].start, RUN_END(RUNS(b)[j]));
+			++j;
+		}
+	}
+
+	return SUCCESS;
+}
+
+/*
+* the first container has the smaller (or same) type. the result may come
+* out in any layout; AppendContainer shrinks it to the best one.
+*/
+static int AndContainers(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	switch (a->type * 3 + b->type)
+	{
+		case ARRAY_CONTAINER * 3 + ARRAY_CONTAINER:
+			return AndArrayArray(a, b, out);
+		case ARRAY_CONTAINER * 3 + BITMAP_CONTAINER:
+			return AndArrayBitmap(a, b, out);
+		case ARRAY_CONTAINER * 3 + RUN_CONTAINER:
+			return AndArrayRuns(a, b, out);
+		case BITMAP_CONTAINER * 3 + BITMAP_CONTAINER:
+			return AndBitmapBitmap(a, b, out);
+		case BITMAP_CONTAINER * 3 + RUN_CONTAINER:
+			return AndBitmapRuns(a, b, out);
+		default:
+			return AndRunsRuns(a, b, out);
+	}
+}
+
+static int OrContainers(const container_t *a, const container_t *b,
+															container_t *out)
+{
+	switch (a->type * 3 + b->type)
+	{
+		case ARRAY_CONTAINER * 3 + ARRAY_CONTAINER:
+			return OrArrayArray(a, b, out);
+		case ARRAY_CONTAINER * 3 + BITMAP_CONTAINER:
+			return OrArrayBitmap(a, b, out);
+		case BITMAP_CONTAINER * 3 + BITMAP_CONTAINER:
+			return OrBitmapBitmap(a, b, out);
+		case BITMAP_CONTAINER * 3 + RUN_CONTAINER:
+			return OrBitmapRuns(a, b, out);
+		default:
+			return OrRunsRunsOrArray(a, b, out);
+	}
+}
+
+static int CopyContainer(const container_t *c, container_t *out)
+{
+	int status = SUCCESS;
+
+	switch (c->type)
+	{
+		case ARRAY_CONTAINER:
+			status = InitArray(out, c->key, c->size);
+			break;
+
+		case BITMAP_CONTAINER:
+			status = InitBitmap(out, c->key);
+			break;
+
+		default:
+			status = InitRuns(out, c->key, c->size);
+	}
+
+	if (SUCCESS != status)
+	{
+		return status;
+	}
+
+	out->size = c->size;
+	out->cardinality = c->cardinality;
+	memcpy((void *)PayloadOf(out), PayloadOf(c), PayloadBytes(c));
+
+	return SUCCESS;
+}
+
+typedef int (*pair_func_t)(const container_t *, const container_t *,
+															container_t *);
+
+static roaring_t *Combine(const roaring_t *r1, const roaring_t *r2,
+											pair_func_t pair_func, int keep_lone)
+{
+	roaring_t *res = NULL;
+	const container_t *a = NULL, *b = NULL, *temp = NULL;
+	container_t out = {0};
+	size_t i = 0, j = 0;
+	int status = SUCCESS;
+
+	res = RoaringCreate();
+	if (NULL == res)
+	{
+		return NULL;
+	}
+
+	while (SUCCESS == status &&
+			(i < r1->num_of_containers || j < r2->num_of_containers))
+	{
+		a = (i < r1->num_of_containers) ? &r1->containers[i] : NULL;
+		b = (j < r2->num_of_containers) ? &r2->containers[j] : NULL;
+
+		if (NULL != a && NULL != b && a->key == b->key)
+		{
+			if (a->type > b->type)
+			{
+				temp = a;
+				a = b;
+				b = temp;
+			}
+
+			status = pair_func(a, b, &out);
+			if (SUCCESS == status)
+			{
+				status = AppendContainer(res, &out);
+			}
+			++i;
+			++j;
+			continue;
+		}
+
+		if (NULL == b || (NULL != a && a->key < b->key))
+		{
+			++i;
+		}
+		else
+		{
+			a = b;
+			++j;
+		}
+
+		if (keep_lone)
+		{
+			status = CopyContainer(a, &out);
+			if (SUCCESS == status)
+			{
+				status = AppendContainer(res, &out);
+			}
+		}
+	}
+
+	if (SUCCESS != status)
+	{
+		RoaringDestroy(res);
+
+		return NULL;
+	}
+
+	return res;
+}
+
+/*
+* receives two compressed bitmaps.
+* creates a new bitmap holding every value that is in either of them.
+* returns the new bitmap if succeeded, NULL otherwise.
+* O(n1 + n2) with a specialized merge for every container pair.
+*/
+roaring_t *RoaringUnion(const roaring_t *roaring1, const roaring_t *roaring2)
+{
+	assert(roaring1);
+	assert(roaring2);
+
+	return Combine(roaring1, roaring2, OrContainers, 1);
+}
+
+/*
+* receives two compressed bitmaps.
+* creates a new bitmap holding the values that are in both of them.
+* returns the new bitmap if succeeded, NULL otherwise.
+* O(n1 + n2) with a specialized merge for every container pair, and chunks
+* present in only one of the inputs are skipped without being read.
+*/
+roaring_t *RoaringIntersection(const roaring_t *roaring1,
+												const roaring_t *roaring2)
+{
+	assert(roaring1);
+	assert(roaring2);
+
+	return Combine(roaring1, roaring2, AndContainers, 0);
+}
+
+/****************************** serialization *******************************/
+
+/*
+* receives a compressed bitmap.
+* returns the number of bytes RoaringSerialize will write.
+* O(number of containers).
+*/
+size_t RoaringSerializedSize(const roaring_t *roaring)
+{
+	size_t bytes = sizeof(unsigned int), i = 0;
+
+	assert(roaring);
+
+	for (i = 0; i < roaring->num_of_containers; ++i)
+	{
+		bytes += sizeof(serial_header_t) +
+							PayloadBytes(&roaring->containers[i]);
+	}
+
+	return bytes;
+}
+
+/*
+* receives a compressed bitmap and a buffer of RoaringSerializedSize bytes.
+* writes the container count, then every container's header and payload,
+* in native byte order and each container in its current layout.
+* returns the number of bytes written.
+* O(n).
+*/
+size_t RoaringSerialize(const roaring_t *roaring, void *buffer)
+{
+	char *runner = buffer;
+	unsigned int num_of_containers = 0;
+	serial_header_t header = {0};
+	const container_t *c = NULL;
+	size_t i = 0;
+
+	assert(roaring);
+	assert(buffer);
+
+	num_of_containers = (unsigned int)roaring->num_of_containers;
+	memcpy(runner, &num_of_containers, sizeof(unsigned int));
+	runner += sizeof(unsigned int);
+
+	for (i = 0; i < roaring->num_of_containers; ++i)
+	{
+		c = &roaring->containers[i];
+		header.key = c->key;
+		header.type = c->type;
+		header.cardinality = (unsigned int)c->cardinality;
+		header.size = (unsigned int)c->size;
+
+		memcpy(runner, &header, sizeof(serial_header_t));
+		runner += sizeof(serial_header_t);
+		memcpy(runner, PayloadOf(c), PayloadBytes(c));
+		runner += PayloadBytes(c);
+	}
+
+	return (size_t)(runner - (char *)buffer);
+}
+
+/*
+* recounts a container read from a buffer and checks it is well formed:
+* array values strictly increasing, runs inside the chunk, sorted and apart,
+* and a nonzero cardinality matching the contents. returns 1 if it is.
+*/
+static int IsValidContainer(const container_t *c)
+{
+	size_t cardinality = 0, i = 0;
+
+	switch (c->type)
+	{
+		case ARRAY_CONTAINER:
+			for (i = 1; i < c->size; ++i)
+			{
+				if (ARRAY(c)[i - 1] >= ARRAY(c)[i])
+				{
+					return 0;
+				}
+			}
+			cardinality = c->size;
+			break;
+
+		case BITMAP_CONTAINER:
+			cardinality = BitsArrayCountOnBuffer(WORDS(c), BITMAP_WORDS);
+			break;
+
+		case RUN_CONTAINER:
+			for (i = 0; i < c->size; ++i)
+			{
+				if (RUN_END(RUNS(c)[i]) >= CHUNK_SIZE ||
+					(0 < i && RUNS(c)[i].start <= RUN_END(RUNS(c)[i - 1])))
+				{
+					return 0;
+				}
+				cardinality += (size_t)RUNS(c)[i].length + 1;
+			}
+			break;
+	}
+
+	return (0 < cardinality && cardinality == c->cardinality);
+}
+
+static int ReadContainer(const serial_header_t *header, const char *payload,
+											size_t bytes_left, container_t *c)
+{
+	int status = SUCCESS;
+
+	switch (header->type)
+	{
+		case ARRAY_CONTAINER:
+			if (header->size != header->cardinality ||
+				header->size > ARRAY_MAX ||
+				ARRAY_BYTES(header->size) > bytes_left)
+			{
+				return MALLOC_FAIL;
+			}
+			status = InitArray(c, header->key, MAX(header->size, 1));
+			break;
+
+		case BITMAP_CONTAINER:
+			if (BITMAP_BYTES > bytes_left)
+			{
+				return MALLOC_FAIL;
+			}
+			status = InitBitmap(c, header->key);
+			break;
+
+		case RUN_CONTAINER:
+			if (header->size > CHUNK_SIZE / 2 ||
+				RUN_BYTES(header->size) > bytes_left)
+			{
+				return MALLOC_FAIL;
+			}
+			status = InitRuns(c, header->key, header->size);
+			break;
+
+		default:
+			return MALLOC_FAIL;
+	}
+
+	if (SUCCESS != status)
+	{
+		return status;
+	}
+
+	c->size = header->size;
+	c->cardinality = header->cardinality;
+	memcpy((void *)PayloadOf(c), payload, PayloadBytes(c));
+
+	if (!IsValidContainer(c))
+	{
+		FreeContainer(c);
+
+		return MALLOC_FAIL;
+	}
+
+	return SUCCESS;
+}
+
+/*
+* receives a buffer written by RoaringSerialize and its size in bytes.
+* creates the compressed bitmap it describes.
+* returns the bitmap if succeeded, NULL if out of memory or the buffer is
+* truncated or malformed.
+* O(n).
+*/
+roaring_t *RoaringDeserialize(const void *buffer, size_t size)
+{
+	roaring_t *roaring = NULL;
+	const char *runner = buffer;
+	const char *end = (const char *)buffer + size;
+	unsigned int num_of_containers = 0, i = 0;
+	serial_header_t header = {0};
+	container_t c = {0};
+
+	assert(buffer);
+
+	if (size < sizeof(unsigned int))
+	{
+		return NULL;
+	}
+
+	memcpy(&num_of_containers, runner, sizeof(unsigned int));
+	runner += sizeof(unsigned int);
+
+	roaring = RoaringCreate();
+	if (NULL == roaring ||
+		MALLOC_FAIL == Reserve(roaring, MIN(num_of_containers, CHUNK_SIZE)))
+	{
+		free(roaring);
+
+		return NULL;
+	}
+
+	for (i = 0; i < num_of_containers; ++i)
+	{
+		if ((size_t)(end - runner) < sizeof(serial_header_t))
+		{
+			break;
+		}
+
+		memcpy(&header, runner, sizeof(serial_header_t));
+		runner += sizeof(serial_header_t);
+
+		if ((0 < roaring->num_of_containers &&
+			roaring->containers[roaring->num_of_containers - 1].key >=
+																header.key) ||
+			SUCCESS != ReadContainer(&header, runner,
+											(size_t)(end - runner), &c))
+		{
+			break;
+		}
+
+		runner += PayloadBytes(&c);
+		if (MALLOC_FAIL == InsertContainer(roaring,
+											roaring->num_of_containers, &c))
+		{
+			FreeContainer(&c);
+			break;
+		}
+	}
+
+	if (i < num_of_containers)
+	{
+		RoaringDestroy(roaring);
+
+		return NULL;
+	}
+
+	return roaring;
+}
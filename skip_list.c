@@ -0,0 +1,716 @@
+#include <assert.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#include "skip_list.h"
+
+/*
+*	Lock-free ordered map of unique datas (Fraser / Herlihy-Shavit). every
+*	next pointer carries a mark in its low bit: a marked next[level] means
+*	its node is being removed from that level. removers mark their node top
+*	down, and the level 0 mark decides which remover won. any thread that
+*	meets a marked node on its way snips it out with one CAS. lookups and
+*	scans only read, they never write and never wait.
+*
+*	unlinked nodes are freed with epoch based reclamation: a thread inside a
+*	list operation publishes the global epoch it saw, and the global epoch
+*	only moves past e + 1 once no thread is left in epoch e. a thread
+*	retiring in epoch e may unlink while the global epoch is already e + 1,
+*	so its node is freed once the global epoch reaches e + 3. the epoch
+*	state is per thread (one slot of a fixed table) and shared by every
+*	skip list. a thread that finds all MAX_THREADS slots taken waits until
+*	another thread gives its slot back with SkipListThreadExit.
+*/
+#ifndef __GNUC__
+#error "skip_list.c needs the __atomic builtins and __thread (gcc or clang)"
+#endif
+
+#define MAX_LEVEL 16 /*1 in 4 nodes goes up a level, 4^16 datas*/
+#define MAX_THREADS 256
+#define CACHE_LINE 64
+#define RETIRES_PER_ADVANCE 32
+#define NUM_OF_EPOCHS 3
+#define IS_MARKED(node) ((size_t)(node) & 1)
+#define MARKED(node) ((skip_node_t *)((size_t)(node) | 1))
+#define UNMARKED(node) ((skip_node_t *)((size_t)(node) & ~(size_t)1))
+#define LOAD(field) __atomic_load_n(&(field), __ATOMIC_ACQUIRE)
+#define STORE(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELEASE)
+#define CAS(field, expected, desired) __atomic_compare_exchange_n(&(field), \
+		(expected), (desired), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define COMPARE(data1, data2) list->cmp_func((data1), (data2), list->param)
+
+enum return_status
+{
+	SUCCESS,
+	MALLOC_FAIL,
+	DUPLICATE
+};
+
+typedef struct skip_node_t skip_node_t;
+
+struct skip_node_t
+{
+	void *data;
+	skip_node_t *retired_next; /*limbo list link, readers never follow it*/
+	size_t owners; /*the inserter still linking it, and a remover*/
+	size_t height;
+	skip_node_t *next[1]; /*really height entries*/
+};
+
+struct skip_list_t
+{
+	skip_node_t *head; /*MAX_LEVEL entries, no data*/
+	compare_func_t cmp_func;
+	void *param;
+	size_t num_of_elements;
+};
+
+/*one thread's epoch state, on cache lines of its own*/
+typedef struct epoch_record_t
+{
+	size_t in_use;
+	size_t is_active;
+	size_t epoch;
+	size_t nesting;
+	size_t num_of_retires;
+	unsigned long random_state;
+	skip_node_t *limbo[NUM_OF_EPOCHS];
+	char padding[CACHE_LINE];
+} epoch_record_t;
+
+static size_t global_epoch = NUM_OF_EPOCHS;
+static size_t num_of_records = 0;
+static epoch_record_t records[MAX_THREADS];
+static __thread epoch_record_t *my_record = NULL;
+
+static skip_node_t *CreateNode(void *data, size_t height)
+{
+	skip_node_t *node = malloc(sizeof(skip_node_t) +
+								(height - 1) * sizeof(skip_node_t *));
+	size_t level = 0;
+
+	if (node)
+	{
+		node->data = data;
+		node->retired_next = NULL;
+		node->owners = 2;
+		node->height = height;
+		for (level = 0; level < height; ++level)
+		{
+			node->next[level] = NULL;
+		}
+	}
+
+	return node;
+}
+
+/****************************** epoch reclamation ***************************/
+
+/*
+*	the calling thread's slot, claimed on its first use of any list. while
+*	every slot is taken it yields and scans again.
+*/
+static epoch_record_t *MyRecord(void)
+{
+	size_t i = 0, expected = 0;
+
+	if (my_record)
+	{
+		return my_record;
+	}
+
+	for (i = 0; ; i = (i + 1) % MAX_THREADS)
+	{
+		expected = 0;
+		if (CAS(records[i].in_use, &expected, 1))
+		{
+			break;
+		}
+
+		if (MAX_THREADS - 1 == i)
+		{
+			sched_yield();
+		}
+	}
+
+	expected = LOAD(num_of_records);
+	while (expected <= i && !CAS(num_of_records, &expected, i + 1))
+	{
+	}
+
+	my_record = &records[i];
+	if (0 == my_record->random_state)
+	{
+		my_record->random_state = 0x9e3779b97f4a7c15UL * (i + 1);
+	}
+
+	return my_record;
+}
+
+static void FreeLimbo(epoch_record_t *record, size_t bucket)
+{
+	skip_node_t *node = record->limbo[bucket], *next = NULL;
+
+	record->limbo[bucket] = NULL;
+	while (node)
+	{
+		next = node->retired_next;
+		free(node);
+		node = next;
+	}
+}
+
+/*moves the global epoch on if every active thread has seen it*/
+static void TryAdvance(void)
+{
+	size_t epoch = LOAD(global_epoch);
+	size_t count = LOAD(num_of_records), i = 0;
+
+	for (i = 0; i < count; ++i)
+	{
+		if (LOAD(records[i].is_active) && LOAD(records[i].epoch) != epoch)
+		{
+			return;
+		}
+	}
+
+	CAS(global_epoch, &epoch, epoch + 1);
+}
+
+/*
+*	enters a critical section: nodes read from now on stay allocated until
+*	the matching Exit. sections nest.
+*/
+static epoch_record_t *Enter(void)
+{
+	epoch_record_t *record = MyRecord();
+	size_t epoch = 0, old = 0, i = 0;
+
+	if (0 == record->nesting++)
+	{
+		__atomic_store_n(&record->is_active, 1, __ATOMIC_SEQ_CST);
+		epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+
+		old = record->epoch;
+		if (epoch != old)
+		{
+			/*the buckets hold epochs old - 2 to old*/
+			for (i = 0; i < NUM_OF_EPOCHS && i <= old; ++i)
+			{
+				if (old - i + NUM_OF_EPOCHS <= epoch)
+				{
+					FreeLimbo(record, (old - i) % NUM_OF_EPOCHS);
+				}
+			}
+			STORE(record->epoch, epoch);
+		}
+	}
+
+	return record;
+}
+
+static void Exit(epoch_record_t *record)
+{
+	if (0 == --record->nesting)
+	{
+		STORE(record->is_active, 0);
+	}
+}
+
+/*node must be unreachable from the list already*/
+static void Retire(epoch_record_t *record, skip_node_t *node)
+{
+	size_t bucket = record->epoch % NUM_OF_EPOCHS;
+
+	node->retired_next = record->limbo[bucket];
+	record->limbo[bucket] = node;
+
+	if (0 == ++record->num_of_retires % RETIRES_PER_ADVANCE)
+	{
+		TryAdvance();
+	}
+}
+
+/*
+*	This function lets the calling thread enter a read section, inside
+*	which iterators stay valid. every SkipListEnter must be matched by a
+*	SkipListExit on the same thread. sections nest.
+*/
+void SkipListEnter(void)
+{
+	Enter();
+}
+
+void SkipListExit(void)
+{
+	assert(my_record && 0 < my_record->nesting);
+
+	Exit(my_record);
+}
+
+/*
+*	This function waits until every thread that was inside a list operation
+*	or read section has left it, so datas removed before the call can no
+*	longer be read by anyone and may be freed. it must not be called inside
+*	a read section.
+*/
+void SkipListSynchronize(void)
+{
+	size_t target = LOAD(global_epoch) + 2;
+
+	assert(!my_record || 0 == my_record->nesting);
+
+	while (LOAD(global_epoch) < target)
+	{
+		TryAdvance();
+	}
+}
+
+/*
+*	This function gives the calling thread's epoch slot back, for threads
+*	that are about to exit, or to a thread waiting for one. nodes it
+*	retired are freed by the next thread that takes the slot.
+*/
+void SkipListThreadExit(void)
+{
+	if (my_record)
+	{
+		assert(0 == my_record->nesting);
+
+		STORE(my_record->in_use, 0);
+		my_record = NULL;
+	}
+}
+
+/********************************* skip list ********************************/
+
+/*
+*	This function creates an empty skip list.
+*	Arguements = comparator, user parameters.
+*	Return value - list handle, NULL on failure.
+*/
+skip_list_t *SkipListCreate(compare_func_t cmp_func, void *param)
+{
+	skip_list_t *list = NULL;
+
+	assert(cmp_func);
+
+	list = malloc(sizeof(skip_list_t));
+	if (!list)
+	{
+		return NULL;
+	}
+
+	list->head = CreateNode(NULL, MAX_LEVEL);
+	if (!list->head)
+	{
+		free(list);
+
+		return NULL;
+	}
+
+	list->cmp_func = cmp_func;
+	list->param = param;
+	list->num_of_elements = 0;
+
+	return list;
+}
+
+/*
+*	This function frees the list and its nodes (not the datas). no other
+*	thread may be using the list.
+*/
+void SkipListDestroy(skip_list_t *list)
+{
+	skip_node_t *node = NULL, *next = NULL;
+
+	assert(list);
+
+	node = list->head;
+	while (node)
+	{
+		next = UNMARKED(node->next[0]);
+		free(node);
+		node = next;
+	}
+
+	free(list);
+}
+
+/*1 + one more level for each 2 random bits that are both 0*/
+static size_t RandomHeight(epoch_record_t *record)
+{
+	unsigned long bits = record->random_state;
+	size_t height = 1;
+
+	bits ^= bits << 13;
+	bits ^= bits >> 7;
+	bits ^= bits << 17;
+	record->random_state = bits;
+
+	for (; height < MAX_LEVEL && 0 == (bits & 3); bits >>= 2)
+	{
+		++height;
+	}
+
+	return height;
+}
+
+/*
+*	fills preds and succs with the last node before data and the first node
+*	not before it on every level, snipping out marked nodes on the way.
+*	returns 1 if succs[0] holds data.
+*/
+static int Find(skip_list_t *list, const void *data, skip_node_t **preds,
+														skip_node_t **succs)
+{
+	skip_node_t *pred = NULL, *curr = NULL, *succ = NULL;
+	size_t level = 0;
+	int retry = 1;
+
+	while (retry)
+	{
+		retry = 0;
+		pred = list->head;
+
+		for (level = MAX_LEVEL; level-- > 0 && !retry;)
+		{
+			curr = UNMARKED(LOAD(pred->next[level]));
+			while (curr)
+			{
+				succ = LOAD(curr->next[level]);
+				if (IS_MARKED(succ))
+				{
+					/*pred moved on or is being removed: start over*/
+					if (!CAS(pred->next[level], &curr, UNMARKED(succ)))
+					{
+						retry = 1;
+						break;
+					}
+
+					curr = UNMARKED(succ);
+				}
+				else if (COMPARE(curr->data, data) < 0)
+				{
+					pred = curr;
+					curr = succ;
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			preds[level] = pred;
+			succs[level] = curr;
+		}
+	}
+
+	return (succs[0] && 0 == COMPARE(succs[0]->data, data));
+}
+
+/*called by both owners of a removed node, the last one retires it*/
+static void ReleaseOwner(skip_list_t *list, epoch_record_t *record,
+															skip_node_t *node)
+{
+	skip_node_t *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+
+	if (0 == __atomic_sub_fetch(&node->owners, 1, __ATOMIC_ACQ_REL))
+	{
+		/*the inserter is done linking, so this unlinks every level*/
+		Find(list, node->data, preds, succs);
+		Retire(record, node);
+	}
+}
+
+/*
+*	return value - SUCCESS, DUPLICATE if an equal data is in already, or
+*	MALLOC_FAIL.
+*	arguments - list handle, void *data to insert.
+*	expected O(log n), lock-free.
+*/
+int SkipListInsert(skip_list_t *list, void *data)
+{
+	skip_node_t *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+	skip_node_t *node = NULL, *expected = NULL;
+	epoch_record_t *record = NULL;
+	size_t level = 0, height = 0;
+
+	assert(list);
+	assert(data); /*cant compare NULL*/
+
+	record = Enter();
+	height = RandomHeight(record);
+	node = CreateNode(data, height);
+	if (!node)
+	{
+		Exit(record);
+
+		return MALLOC_FAIL;
+	}
+
+	/*level 0 decides: once linked there, the data is in the list*/
+	for (;;)
+	{
+		if (Find(list, data, preds, succs))
+		{
+			free(node);
+			Exit(record);
+
+			return DUPLICATE;
+		}
+
+		for (level = 0; level < height; ++level)
+		{
+			node->next[level] = succs[level];
+		}
+
+		expected = succs[0];
+		if (CAS(preds[0]->next[0], &expected, node))
+		{
+			break;
+		}
+	}
+	__atomic_add_fetch(&list->num_of_elements, 1, __ATOMIC_RELAXED);
+
+	/*the upper levels are shortcuts, linked unless a remover got there*/
+	for (level = 1; level < height; ++level)
+	{
+		for (;;)
+		{
+			expected = LOAD(node->next[level]);
+			if (IS_MARKED(expected) || (expected != succs[level] &&
+				!CAS(node->next[level], &expected, succs[level])))
+			{
+				break;
+			}
+
+			expected = succs[level];
+			if (CAS(preds[level]->next[level], &expected, node))
+			{
+				break;
+			}
+
+			if (!Find(list, data, preds, succs) || succs[0] != node)
+			{
+				break;
+			}
+		}
+	}
+
+	ReleaseOwner(list, record, node);
+	Exit(record);
+
+	return SUCCESS;
+}
+
+/*
+*	return value - the removed data, NULL if no data equal to data is in.
+*	concurrent lookups may still read the removed data until
+*	SkipListSynchronize returns.
+*	arguments - list handle, void *data to remove.
+*	expected O(log n), lock-free.
+*/
+void *SkipListRemove(skip_list_t *list, const void *data)
+{
+	skip_node_t *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+	skip_node_t *node = NULL, *succ = NULL;
+	epoch_record_t *record = NULL;
+	size_t level = 0;
+	void *removed = NULL;
+
+	assert(list);
+
+	record = Enter();
+	if (!Find(list, data, preds, succs))
+	{
+		Exit(record);
+
+		return NULL;
+	}
+
+	node = succs[0];
+	for (level = node->height - 1; level > 0; --level)
+	{
+		succ = LOAD(node->next[level]);
+		while (!IS_MARKED(succ) &&
+				!CAS(node->next[level], &succ, MARKED(succ)))
+		{
+		}
+	}
+
+	/*the remover that marks level 0 is the one that removed the data*/
+	succ = LOAD(node->next[0]);
+	while (!IS_MARKED(succ))
+	{
+		if (CAS(node->next[0], &succ, MARKED(succ)))
+		{
+			removed = node->data;
+			__atomic_sub_fetch(&list->num_of_elements, 1, __ATOMIC_RELAXED);
+			Find(list, data, preds, succs);
+			ReleaseOwner(list, record, node);
+			break;
+		}
+	}
+
+	Exit(record);
+
+	return removed;
+}
+
+/*first unmarked node not before data, on level 0. read only*/
+static skip_node_t *LowerBound(skip_list_t *list, const void *data)
+{
+	skip_node_t *pred = list->head, *curr = NULL;
+	size_t level = MAX_LEVEL;
+
+	while (level-- > 0)
+	{
+		curr = UNMARKED(LOAD(pred->next[level]));
+		while (curr && COMPARE(curr->data, data) < 0)
+		{
+			pred = curr;
+			curr = UNMARKED(LOAD(curr->next[level]));
+		}
+	}
+
+	while (curr && IS_MARKED(LOAD(curr->next[0])))
+	{
+		curr = UNMARKED(LOAD(curr->next[0]));
+	}
+
+	return curr;
+}
+
+/*
+*	return value - the data equal to data, NULL if there is none.
+*	arguments - list handle, void *data to find.
+*	expected O(log n). never writes and never waits.
+*/
+void *SkipListFind(skip_list_t *list, const void *data)
+{
+	skip_node_t *node = NULL;
+	epoch_record_t *record = NULL;
+	void *found = NULL;
+
+	assert(list);
+
+	record = Enter();
+	node = LowerBound(list, data);
+	if (node && 0 == COMPARE(node->data, data))
+	{
+		found = node->data;
+	}
+	Exit(record);
+
+	return found;
+}
+
+/*
+*	return value - number of datas. exact only while no other thread is
+*	inserting or removing.
+*/
+size_t SkipListCount(const skip_list_t *list)
+{
+	assert(list);
+
+	return __atomic_load_n(&list->num_of_elements, __ATOMIC_RELAXED);
+}
+
+/*
+*	return value - iter to the first data, SkipListEnd if the list is empty.
+*	arguments - list handle.
+*	iterators are valid only inside a read section (SkipListEnter).
+*/
+sl_iter SkipListBegin(skip_list_t *list)
+{
+	skip_node_t *node = NULL;
+
+	assert(list);
+	assert(my_record && 0 < my_record->nesting);
+
+	node = UNMARKED(LOAD(list->head->next[0]));
+	while (node && IS_MARKED(LOAD(node->next[0])))
+	{
+		node = UNMARKED(LOAD(node->next[0]));
+	}
+
+	return ((sl_iter)node);
+}
+
+sl_iter SkipListEnd(skip_list_t *list)
+{
+	assert(list);
+	(void)list;
+
+	return NULL;
+}
+
+/*
+*	return value - iter to the first data not smaller than data, or
+*	SkipListEnd.
+*	arguments - list handle, void *data. inside a read section only.
+*/
+sl_iter SkipListLowerBound(skip_list_t *list, const void *data)
+{
+	assert(list);
+	assert(my_record && 0 < my_record->nesting);
+
+	return ((sl_iter)LowerBound(list, data));
+}
+
+/*
+*	return value - next iterator, skipping datas being removed.
+*	arguments - iterator (not SkipListEnd). inside a read section only.
+*/
+sl_iter SkipListNext(sl_iter iter)
+{
+	skip_node_t *node = (skip_node_t *)iter;
+
+	assert(node);
+
+	do
+	{
+		node = UNMARKED(LOAD(node->next[0]));
+	}
+	while (node && IS_MARKED(LOAD(node->next[0])));
+
+	return ((sl_iter)node);
+}
+
+void *SkipListGetData(sl_iter iter)
+{
+	assert(iter);
+
+	return (((skip_node_t *)iter)->data);
+}
+
+/*
+*	return value - 0 if every action succeeded, 1 if one failed.
+*	arguments - list handle, range ends, action function, param
+*	this function performs the given action for each data from low to high
+*	(both included), in order, inside a read section of its own. datas
+*	inserted or removed meanwhile may or may not be seen.
+*/
+int SkipListForEachInRange(skip_list_t *list, const void *low,
+							const void *high, action_func_t act_func,
+																void *param)
+{
+	epoch_record_t *record = NULL;
+	skip_node_t *node = NULL;
+	int func_result = 0;
+
+	assert(list);
+	assert(act_func);
+
+	record = Enter();
+	node = LowerBound(list, low);
+	while (node && COMPARE(node->data, high) <= 0 && !func_result)
+	{
+		func_result = act_func(node->data, param);
+		node = (skip_node_t *)SkipListNext((sl_iter)node);
+	}
+	Exit(record);
+
+	return (0 != func_result);
+}